@@ -31,6 +31,12 @@ def parse_args():
         default=100,
         help="Maximum number of records to display (default: 100)",
     )
+    parser.add_argument(
+        "--stream",
+        type=str,
+        default="default",
+        help="Stream to show (people_count.stream_id, default: default)",
+    )
     return parser.parse_args()
 
 
@@ -39,6 +45,7 @@ args = parse_args()
 DB_PATH = args.db
 REFRESH_INTERVAL = args.refresh
 DATA_LIMIT = args.limit
+STREAM_ID = args.stream
 
 st.set_page_config(page_title="Smart Counter Analytics", layout="wide")
 
@@ -46,6 +53,7 @@ st.set_page_config(page_title="Smart Counter Analytics", layout="wide")
 col_title, col_reset = st.columns([4, 1])
 with col_title:
     st.title("🚗 Smart Counter: Real-Time Analytics")
+    st.caption(f"Stream: {STREAM_ID}")
 with col_reset:
     st.write("")  # Spacer
     if st.button("🔄 Reset Counters", help="Clear all counter data from database"):
@@ -53,7 +61,9 @@ with col_reset:
             if os.path.exists(DB_PATH):
                 conn = sqlite3.connect(DB_PATH)
                 cursor = conn.cursor()
-                cursor.execute("DELETE FROM people_count")
+                cursor.execute(
+                    "DELETE FROM people_count WHERE stream_id = ?", (STREAM_ID,)
+                )
                 conn.commit()
                 conn.close()
                 st.success("✅ Counters reset successfully!")
@@ -69,9 +79,13 @@ def load_data():
 
     try:
         conn = sqlite3.connect(DB_PATH)
-        # Читаем последние N записей (задается параметром --limit)
-        query = f"SELECT timestamp, in_count, out_count FROM people_count ORDER BY timestamp DESC LIMIT {DATA_LIMIT}"
-        df = pd.read_sql(query, conn)
+        # Читаем последние N записей (задается параметром --limit) одного потока:
+        # у каждого потока демона свой ряд счетчиков
+        query = (
+            "SELECT timestamp, in_count, out_count FROM people_count "
+            "WHERE stream_id = ? ORDER BY timestamp DESC LIMIT ?"
+        )
+        df = pd.read_sql(query, conn, params=(STREAM_ID, DATA_LIMIT))
         conn.close()
 
         # Конвертируем timestamp в datetime
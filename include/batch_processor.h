@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "counting_stream.h"
+#include "database.h"
+#include "detector.h"
+
+// Настройки офлайн-пересчета архивных записей
+struct BatchConfig
+{
+    std::string model_path;
+    bool use_gpu = false;
+    std::string head_name;        // Пусто = определить по модели
+    TilingConfig tiling;
+    int workers = 0;              // 0 = по числу ядер (на GPU - 1)
+    double chunk_seconds = 600.0; // Длина куска
+    double overlap_seconds = 10.0; // Разогрев трекера перед началом куска
+    StreamConfig stream;          // Линия и порог (source подставляется для каждого файла); yuv не поддерживается
+};
+
+// Результат обработки одного куска файла
+struct ChunkResult
+{
+    std::string file;
+    int index = 0;
+    int64_t start_frame = 0; // Номинальный диапазон [start_frame, end_frame)
+    int64_t end_frame = 0;
+    double fps = 25.0;
+    bool ok = false;
+
+    int count_in = 0;
+    int count_out = 0;
+    std::vector<CrossingEvent> events;        // Засчитанные (внутри номинального диапазона)
+    std::vector<CrossingEvent> warmup_events; // Увиденные в перекрытии, но принадлежащие предыдущему куску
+    double processing_seconds = 0.0;
+};
+
+// Офлайн-режим: длинные записи режутся на куски с перекрытием, куски обрабатываются
+// параллельно (у каждого рабочего свой декодер, детектор и трекер), а затем сшиваются.
+//
+// Сшивка: каждое пересечение принадлежит ровно одному куску - тому, в чей номинальный диапазон
+// попал его кадр. Перекрытие перед куском нужно, чтобы трекер "разогрелся": треки, пересекающие
+// границу куска, уже имеют историю, а ID, засчитанные в перекрытии, не засчитываются повторно.
+class BatchProcessor
+{
+public:
+    explicit BatchProcessor(const BatchConfig &config);
+
+    // input - файл или каталог с видео. Возвращает код выхода для main()
+    int run(const std::string &input, Database &db);
+
+private:
+    BatchConfig config;
+
+    std::vector<ChunkResult> plan_chunks(const std::vector<std::string> &files) const;
+    void process_chunk(ChunkResult &chunk, YOLODetector &detector) const;
+    void print_report(const std::vector<ChunkResult> &chunks, double wall_seconds) const;
+};
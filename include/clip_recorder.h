@@ -0,0 +1,112 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Настройки записи клипов по событиям
+struct ClipConfig
+{
+    std::string dir;              // Пусто = запись клипов выключена
+    double pre_seconds = 5.0;     // Сколько секунд до события
+    double post_seconds = 5.0;    // Сколько секунд после события
+    double max_seconds = 60.0;    // Предел длины клипа при слиянии серии событий
+    int jpeg_quality = 80;        // Качество кадров в кольцевом буфере
+    int max_width = 1280;         // Кадры шире уменьшаются перед сжатием
+};
+
+// Короткие клипы вокруг пересечений линии вместо записи всего потока.
+//
+// push() только копирует кадр в очередь сжатия; отрисовка (render), уменьшение и JPEG -
+// в фоновом потоке, как в PreviewServer. Кольцевой буфер держит pre_seconds последних кадров.
+// Событие забирает содержимое буфера (без копирования - кадры разделяемые) и дальше копит еще post_seconds.
+// События, попавшие в хвост уже открытого клипа, продлевают его (одна серия = один файл).
+// Готовый клип уходит в поток записи, поэтому основной цикл не ждет ни сжатия, ни диска.
+// Если сжатие не успевает, лишние кадры пропускаются (в клипе будет рывок), а не копятся в памяти.
+class ClipRecorder
+{
+public:
+    ClipRecorder(const ClipConfig &config, const std::string &stream_id, double fps);
+    ~ClipRecorder(); // Дописывает открытый клип и ждет очередь записи
+
+    // Событие на кадре, который будет передан следующим вызовом push().
+    // Возвращает путь к файлу клипа (для записи в БД); файл появится после окончания клипа
+    std::string trigger();
+
+    // Из кадра push() делает кадр клипа (BGR с разметкой); вызывается в фоновом потоке
+    using Render = std::function<cv::Mat(const cv::Mat &)>;
+
+    // Очередной кадр. Без render кадр должен быть готовым BGR; с render - любым (например, сырой YUV).
+    // Кадр копируется, исходник можно переиспользовать
+    void push(const cv::Mat &frame, Render render = nullptr);
+
+    // Закрывает открытый клип и останавливает поток записи
+    void finish();
+
+    int clips_written() const { return written; }
+
+private:
+    // Кадр буфера; jpeg заполняет поток сжатия (nullptr - еще не сжат или пропущен)
+    struct FrameSlot
+    {
+        std::shared_ptr<const std::vector<uint8_t>> jpeg;
+    };
+    using SharedFrame = std::shared_ptr<FrameSlot>;
+
+    struct EncodeJob
+    {
+        cv::Mat frame;
+        Render render;
+        SharedFrame slot;
+        int64_t index;
+    };
+
+    struct Clip
+    {
+        std::string path;
+        std::vector<SharedFrame> frames;
+        int64_t end_frame = 0;   // Номер кадра (push), на котором клип закрывается
+        int64_t limit_frame = 0; // Дальше серию не продлеваем
+        int64_t last_frame = -1; // Номер последнего кадра клипа - запись ждет, пока он сжат
+    };
+
+    ClipConfig config;
+    std::string stream_id;
+    std::string stream_dir;
+    double fps;
+    int pre_frames;
+    int post_frames;
+    int max_frames;
+
+    int64_t pushed = 0; // Сколько кадров прошло через push()
+    std::deque<SharedFrame> ring;
+    std::unique_ptr<Clip> active;
+    size_t max_pending;        // Предел очереди сжатия (~1 секунда кадров)
+    bool drop_warned = false;
+
+    // Очереди сжатия и готовых клипов (общий мьютекс)
+    std::mutex queue_mutex;
+    std::condition_variable encode_cv;  // Есть кадр на сжатие
+    std::condition_variable encoded_cv; // Сжат очередной кадр
+    std::condition_variable queue_cv;   // Есть клип на запись
+    std::deque<EncodeJob> encode_queue;
+    int64_t encoded_upto = 0;           // Все кадры с номером меньше этого обработаны
+    std::deque<std::unique_ptr<Clip>> queue;
+    bool encoder_stopping = false;
+    bool stopping = false;
+    std::thread encoder;
+    std::thread writer;
+    std::atomic<int> written{0};
+
+    std::string make_path() const;
+    void close_active();
+    void encoder_loop();
+    void writer_loop();
+    void write_clip(const Clip &clip);
+};
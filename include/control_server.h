@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Сервер управления на Unix-domain сокете.
+// Протокол текстовый: одна команда на строку, на каждую команду - одна строка ответа.
+// Пример: echo "stats" | socat - UNIX-CONNECT:/tmp/smart_counter.sock
+class ControlServer
+{
+public:
+    // Обработчик получает строку команды и возвращает строку ответа (без '\n')
+    using Handler = std::function<std::string(const std::string &)>;
+
+    ControlServer(const std::string &socket_path, Handler handler);
+    ~ControlServer();
+
+    // Создает сокет и запускает поток приема подключений
+    bool start();
+    void stop();
+
+    const std::string &path() const { return socket_path; }
+
+private:
+    std::string socket_path;
+    Handler handler;
+
+    int listen_fd = -1;
+    std::atomic<bool> running{false};
+    std::thread accept_thread;
+
+    // Клиентские потоки отсоединены; stop() ждет, пока их счетчик не обнулится
+    std::mutex clients_mutex;
+    std::condition_variable clients_done;
+    int active_clients = 0;
+
+    void accept_loop();
+    void serve_client(int client_fd);
+};
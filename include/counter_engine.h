@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "clip_recorder.h"
+#include "counting_stream.h"
+#include "database.h"
+#include "detector.h"
+#include "preview_server.h"
+
+// Движок режима демона: несколько потоков на одной сессии детектора.
+// Команды управления ставятся в очередь из любого потока и применяются
+// между кадрами, поэтому модель не перезагружается, а трекеры и счетчики не теряются.
+// Каждый поток читается в своем потоке захвата, а источник новой команды add открывается
+// во вспомогательном потоке: зависшая камера или долгое подключение RTSP не останавливают подсчет остальных.
+//
+// Команды (одна на строку):
+//   add <id> <source> [loop]   - добавить поток
+//   remove <id>                - удалить поток
+//   line <id> <y>              - передвинуть линию подсчета (-1 = середина кадра)
+//   conf <id> <threshold>      - порог уверенности детектора
+//   pause <id> / resume <id>   - приостановить / продолжить обработку
+//   stats [id]                 - счетчики и FPS
+//   shutdown                   - остановить демон
+class CounterEngine
+{
+public:
+    CounterEngine(YOLODetector &detector, Database &db);
+
+    // Каталог траекторий; у каждого потока свой подкаталог <dir>/<id>
+    void set_trajectory_dir(const std::string &dir) { trajectory_dir = dir; }
+
+    // HTTP-превью (может быть nullptr); потоки регистрируются в нем при добавлении
+    void set_preview(PreviewServer *server) { preview = server; }
+
+    // Клипы по событиям (--clips); у каждого потока свой подкаталог <dir>/<id>
+    void set_clips(const ClipConfig &config) { clip_config = config; }
+
+    // Подсчитываемые классы для потоков, добавленных командой add
+    void set_counted_classes(const std::vector<ClassTrackingConfig> &classes) { counted_classes = classes; }
+
+    // Добавляет поток до запуска run() (например, из --input)
+    bool add_stream(const StreamConfig &config, std::string &error);
+
+    // Потокобезопасно: ставит команду в очередь и ждет ответа после ее применения
+    std::string submit(const std::string &command);
+
+    // Главный цикл: блокирует до shutdown / stop()
+    void run();
+
+    // Можно вызывать из обработчика сигнала
+    void stop() { running = false; }
+
+private:
+    struct PendingCommand
+    {
+        std::string line;
+        std::promise<std::string> reply;
+    };
+
+    // Результат открытия источника во вспомогательном потоке
+    struct OpenedStream
+    {
+        std::string id;
+        std::unique_ptr<CountingStream> stream; // nullptr - источник не открылся
+        std::shared_ptr<std::promise<std::string>> reply;
+    };
+
+    YOLODetector &detector;
+    Database &db;
+
+    std::map<std::string, std::unique_ptr<CountingStream>> streams;
+    std::map<std::string, std::unique_ptr<ClipRecorder>> clips; // Только при --clips
+    std::string trajectory_dir;
+    ClipConfig clip_config;
+    std::vector<ClassTrackingConfig> counted_classes;
+    PreviewServer *preview = nullptr;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<PendingCommand> queue;
+    std::deque<OpenedStream> opened;     // Готовые к вставке потоки (под queue_mutex)
+    std::atomic<bool> frames_ready{false}; // Поток захвата положил кадр
+    std::atomic<bool> running{true};
+
+    // Открываются сейчас (только из потока run()) - чтобы не открыть один id дважды
+    std::set<std::string> opening;
+
+    // Вспомогательные потоки отсоединены; run() перед выходом ждет, пока их счетчик не обнулится
+    std::condition_variable helpers_done;
+    int active_helpers = 0;
+
+    // Применяет накопившиеся команды (только из потока run())
+    void process_commands();
+    std::string apply(const std::string &line);
+    void start_open(const StreamConfig &config, std::shared_ptr<std::promise<std::string>> reply);
+    void start_capture(CountingStream &stream);
+    void attach_stream(std::unique_ptr<CountingStream> stream);
+    void run_helper(std::function<void()> task);
+    std::string stats(const std::string &id) const;
+};
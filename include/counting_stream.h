@@ -0,0 +1,196 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detector.h"
+#include "tracker.h"
+#include "fps_counter.h"
+#include "trajectory_store.h"
+#include "yuv_tensor.h"
+
+// Настройки одного видеопотока
+struct StreamConfig
+{
+    std::string id = "default";
+    std::string source;           // Файл, RTSP-адрес или индекс камеры
+    int line_y = -1;              // Линия подсчета; -1 = середина кадра
+    float conf_threshold = 0.5f;  // Порог уверенности детектора
+    bool loop = false;            // Зацикливать файл (эмуляция камеры)
+    bool yuv = false;             // Брать сырые NV12-кадры декодера (GStreamer), BGR - только по запросу
+    std::vector<ClassTrackingConfig> classes; // Подсчитываемые классы; пусто = только люди
+};
+
+// Пересечение линии одним треком
+struct CrossingEvent
+{
+    int track_id;    // ID внутри класса
+    int class_id;
+    bool is_in;      // true = вход (сверху вниз), false = выход
+    int64_t frame;   // Номер кадра в источнике
+    cv::Point position;
+};
+
+// Счетчики одного класса
+struct ClassCount
+{
+    std::string name;
+    int in = 0;
+    int out = 0;
+};
+
+// Снимок всего, что рисует annotate(): кадр можно отрисовать позже и в другом потоке
+struct FrameOverlay
+{
+    bool yuv = false;                 // Кадр сырой (NV12), перед отрисовкой нужен BGR
+    YuvLayout yuv_layout = YuvLayout::NV12;
+    std::vector<TrackedObject> objects;
+    int line_y = 0;
+    cv::Scalar line_color;
+    int in_count = 0;
+    int out_count = 0;
+    std::map<int, ClassCount> per_class;
+};
+
+// Один поток: захват -> детекция -> трекинг -> подсчет пересечений линии.
+// Настройки (линия, порог, пауза) можно менять между кадрами без пересоздания трекера.
+class CountingStream
+{
+public:
+    explicit CountingStream(const StreamConfig &config);
+    ~CountingStream();
+
+    // Открывает источник; false - источник недоступен
+    bool open();
+
+    // Захват в собственном потоке (режим демона): зависший источник не держит остальные.
+    // on_frame вызывается из потока захвата после каждого кадра (например, чтобы разбудить цикл).
+    // После start_capture() кадры берутся только через take_frame(), read() и seek() не используются
+    void start_capture(std::function<void()> on_frame);
+
+    // Забирает следующий захваченный кадр, не блокируя; false - кадра пока нет
+    // (или поток закончился - тогда is_finished())
+    bool take_frame(cv::Mat &frame);
+
+    // Читает следующий кадр (с перемоткой в режиме loop); false - поток закончился.
+    // В YUV-режиме frame - сырой кадр NV12 (CV_8UC1, высота h * 3 / 2)
+    bool read(cv::Mat &frame);
+
+    // BGR-версия кадра для отрисовки/записи. В BGR-режиме возвращает тот же кадр без копирования
+    cv::Mat to_bgr(const cv::Mat &frame) const;
+
+    // Перемотка к кадру (для обработки файла кусками)
+    bool seek(int64_t frame);
+
+    // Детекция + трекинг + подсчет для одного кадра
+    void process(cv::Mat &frame, YOLODetector &detector);
+
+    // Пересечения на последнем обработанном кадре
+    const std::vector<CrossingEvent> &last_events() const { return events; }
+
+    // Рисует боксы, ID, линию подсчета и панель IN/OUT/INSIDE
+    void annotate(cv::Mat &frame) const;
+
+    // Снимок разметки текущего кадра и отрисовка по нему (BGR-копия сырого кадра + разметка)
+    FrameOverlay overlay() const;
+    static cv::Mat render(const cv::Mat &frame, const FrameOverlay &overlay);
+
+    // Включает запись траекторий треков в dir (сегменты по часу)
+    void enable_trajectories(const std::string &dir);
+
+    // true, если счетчики выросли с последнего вызова (пора писать в БД)
+    bool take_count_update();
+
+    void set_line_y(int y) { config.line_y = y; }
+    void set_conf_threshold(float threshold) { config.conf_threshold = threshold; }
+    void set_paused(bool value) { paused = value; }
+
+    const StreamConfig &get_config() const { return config; }
+    const std::string &id() const { return config.id; }
+    int line_y() const { return current_line_y; }
+    int count_in() const { return in_count; }   // Сумма по всем классам
+    int count_out() const { return out_count; }
+    const std::map<int, ClassCount> &class_counts() const { return per_class; }
+    bool is_paused() const { return paused; }
+    bool is_finished() const { return finished; }
+    bool is_yuv() const { return yuv_mode; }
+    int64_t current_frame() const { return frame_index; }
+    int64_t frame_count() const;
+    double source_fps() const;
+    cv::Size frame_size() const;
+    const FPSCounter &fps() const { return fps_counter; }
+    FPSCounter &fps() { return fps_counter; }
+
+private:
+    StreamConfig config;
+    cv::VideoCapture cap;
+    MultiClassTracker tracker;
+
+    std::set<int64_t> counted_ids; // track_key уже засчитанных треков
+    int current_line_y = 0;
+    int in_count = 0;
+    int out_count = 0;
+    std::map<int, ClassCount> per_class;
+    int last_saved_count = 0; // Чтобы не спамить в БД
+
+    bool paused = false;
+    bool finished = false;
+    double fps_value = 25.0;
+
+    // YUV-режим: кадры идут мимо BGR-конвертации
+    bool yuv_mode = false;
+    YuvLayout yuv_layout = YuvLayout::NV12;
+    cv::Size image_size;
+    cv::Mat pending_frame; // Первый кадр, прочитанный при проверке формата
+
+    bool open_capture();
+    bool open_yuv_capture();
+    bool open_yuv_pipeline(const std::string &formats, cv::Mat &first, YuvLayout &layout);
+    static void draw_overlay(cv::Mat &frame, const FrameOverlay &overlay);
+    int64_t frame_index = -1; // Номер обрабатываемого кадра
+    bool restarted = false;   // Файл начался заново (loop)
+
+    // Состояние чтения: при захвате в отдельном потоке принадлежит ему
+    int64_t read_index = -1;
+    bool read_next(cv::Mat &frame, bool &restart);
+
+    void reset_tracking();
+
+    // Захват в отдельном потоке
+    struct CapturedFrame
+    {
+        cv::Mat frame;
+        int64_t index;
+        bool restarted;
+    };
+    std::thread capture_thread;
+    std::mutex capture_mutex;
+    std::condition_variable capture_cv;
+    std::deque<CapturedFrame> captured;
+    bool capture_done = false;
+    bool capture_stop = false;
+    std::function<void()> on_frame;
+
+    void capture_loop();
+    void stop_capture();
+
+    std::unique_ptr<TrajectoryWriter> trajectories;
+    // Файл: время точки = начало отсчета + позиция в видео (dwell не зависит от скорости обработки)
+    int64_t video_epoch_ms = -1;
+    int64_t last_point_ms = 0;
+    int64_t trajectory_time_ms();
+
+    // Состояние последнего кадра для отрисовки
+    std::vector<TrackedObject> tracked_objects;
+    std::vector<CrossingEvent> events;
+    cv::Scalar line_color;
+
+    FPSCounter fps_counter;
+};
@@ -12,10 +12,31 @@ public:
     // Создает таблицу, если её нет
     void init();
 
-    // Сохраняет счетчики входа и выхода
-    void insert_log(int in_count, int out_count);
+    // Сохраняет счетчики входа и выхода (stream_id - имя потока в режиме демона)
+    void insert_log(int in_count, int out_count, const std::string &stream_id = "default");
+
+    // Итог офлайн-режима по одному файлу (stream_id - имя файла)
+    void insert_batch_total(const std::string &stream_id, int in_count, int out_count);
+
+    // Счетчики одного класса (people_count хранит сумму по всем подсчитываемым классам)
+    void insert_class_log(const std::string &stream_id, int class_id, const std::string &class_name,
+                          int in_count, int out_count);
+
+    // Отдельное пересечение линии (класс, track_id внутри класса, направление, позиция в видео, клип для проверки).
+    // chunk - номер куска в офлайн-режиме (ID треков уникальны только внутри куска), -1 = живой поток
+    void insert_event(const std::string &stream_id, int class_id, int track_id, bool is_in, double video_ms,
+                      const std::string &clip_path = "", int chunk = -1);
+
+    // Пакетная запись (офлайн-режим пишет тысячи событий разом)
+    void begin_transaction();
+    void commit_transaction();
 
 private:
     sqlite3 *db;
     std::string db_path;
-};
\ No newline at end of file
+
+    void exec(const char *sql);
+
+    // Миграция схемы: добавляет колонку в существующую таблицу, если ее еще нет
+    void add_column_if_missing(const std::string &table, const std::string &column, const std::string &definition);
+};
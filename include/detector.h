@@ -3,6 +3,8 @@
 #include <onnxruntime_cxx_api.h>
 #include <vector>
 #include <string>
+#include "yolo_decoder.h"
+#include "yuv_tensor.h"
 
 // Структура для хранения результата детекции
 struct Detection
@@ -12,15 +14,42 @@ struct Detection
     cv::Rect box;
 };
 
+// Настройки тайлового инференса для кадров высокого разрешения (4K):
+// кадр режется на перекрывающиеся тайлы, которые прогоняются одним батчем
+struct TilingConfig
+{
+    bool enabled = false;
+    int cols = 2;            // Количество тайлов по горизонтали
+    int rows = 2;            // Количество тайлов по вертикали
+    float overlap = 0.2f;    // Доля перекрытия соседних тайлов (0.0 - 0.9)
+    bool global_view = true; // Добавлять в батч весь кадр, уменьшенный до входа модели
+    cv::Rect region;         // Область тайлинга (пустая = весь кадр), например зона подсчета
+};
+
 class YOLODetector
 {
 public:
     // Конструктор: загружает модель и настраивает сессию
-    YOLODetector(const std::string &model_path, bool use_cuda = true);
+    // intra_op_threads > 0 ограничивает потоки ONNX Runtime (несколько детекторов на одной машине)
+    YOLODetector(const std::string &model_path, bool use_cuda = true, int intra_op_threads = 0);
 
     // Главный метод: принимает картинку, возвращает список найденных объектов
     std::vector<Detection> detect(cv::Mat &image, float conf_threshold = 0.5);
 
+    // То же для сырого YUV-кадра декодера: тензор собирается прямо из плоскостей Y/UV, без BGR
+    std::vector<Detection> detect_yuv(const cv::Mat &yuv, YuvLayout layout, float conf_threshold = 0.5);
+
+    // Включает/настраивает тайловый режим (используется в detect)
+    void set_tiling(const TilingConfig &config);
+    const TilingConfig &tiling() const { return tiling_config; }
+
+    // Раскладка тайлов для кадра заданного размера (без глобального вида)
+    std::vector<cv::Rect> make_tiles(const cv::Size &frame_size) const;
+
+    // Формат выхода определяется при загрузке; можно задать вручную, если в модели нет метаданных
+    void set_head_format(HeadFormat format);
+    HeadFormat head_format() const { return head; }
+
 private:
     // Внутренние ресурсы ONNX Runtime
     Ort::Env env{nullptr};
@@ -31,7 +60,33 @@ private:
     std::vector<const char *> input_names;
     std::vector<const char *> output_names;
     std::vector<int64_t> input_shape;
+    bool dynamic_batch = false; // Модель принимает батч > 1 (экспорт с dynamic=True)
+
+    TilingConfig tiling_config;
+
+    // Декодер выхода, выбранный под формат головы и число классов
+    HeadFormat head = HeadFormat::YOLOv8;
+    int head_classes = -1; // Число классов, под которое специализирован decoder (-1 = неизвестно)
+    DecodeFn decoder = nullptr;
 
     // Вспомогательный метод для подготовки картинки
     std::vector<float> preprocess(const cv::Mat &image, float &scale);
-};
\ No newline at end of file
+
+    // Препроцессинг: по одной картинке батча на каждую область views.
+    // yuv_layout == nullptr - image в BGR, иначе image - сырой YUV-кадр
+    void make_blob(const cv::Mat &image, const YuvLayout *yuv_layout,
+                   const std::vector<cv::Rect> &views, cv::Mat &blob) const;
+
+    std::vector<Detection> detect_frame(const cv::Mat &image, const YuvLayout *yuv_layout, float conf_threshold);
+
+    // Запускает сессию на батче из batch_size картинок, лежащих подряд в data
+    std::vector<Ort::Value> run(float *data, int64_t batch_size);
+
+    // Разбирает выход модели для одной картинки батча и переводит боксы
+    // в координаты кадра (view - область кадра, поданная на вход модели)
+    void decode(const float *data, const std::vector<int64_t> &output_dims, float conf_threshold,
+                const cv::Rect &view, std::vector<Detection> &candidates) const;
+
+    // Тайловый инференс: все тайлы одним session.Run + слияние боксов между тайлами
+    std::vector<Detection> detect_tiled(const cv::Mat &image, const YuvLayout *yuv_layout, float conf_threshold);
+};
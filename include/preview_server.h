@@ -0,0 +1,92 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Настройки превью
+struct PreviewConfig
+{
+    std::string bind_address = "127.0.0.1"; // 0.0.0.0 - доступ с других машин
+    int port = 8080;                        // 0 = любой свободный (см. port())
+    double max_fps = 10.0;                  // Предел частоты кадров превью
+    int max_width = 960;                    // Кадры шире уменьшаются
+    int jpeg_quality = 70;
+    int max_clients = 16;                   // Одновременных подключений; сверх - 503
+};
+
+// Встроенный HTTP-сервер живого превью (MJPEG) вместо окна cv::imshow.
+//
+//   GET /                 - список потоков
+//   GET /stream/<id>      - multipart/x-mixed-replace, MJPEG
+//   GET /snapshot/<id>    - один JPEG
+//
+// Конвейер спрашивает wants_frame(): пока никто не смотрит (или кадр еще рано по max_fps),
+// он не рисует разметку и не передает кадр. publish() только уменьшает кадр и кладет его в слот -
+// сжатие в JPEG идет в отдельном потоке, клиенты всегда получают самый свежий кадр,
+// медленный клиент пропускает кадры и не тормозит ни конвейер, ни других клиентов.
+// Авторизации нет: при bind_address 0.0.0.0 превью видит любой в сети.
+class PreviewServer
+{
+public:
+    explicit PreviewServer(const PreviewConfig &config);
+    ~PreviewServer();
+
+    bool start();
+    void stop();
+
+    // Фактический порт (если в настройках был 0)
+    int port() const { return bound_port; }
+
+    // Поток появляется в списке и становится доступен по /stream/<id>
+    void add_stream(const std::string &id);
+    void remove_stream(const std::string &id);
+
+    // true, если у потока есть зрители и пора отдать следующий кадр
+    bool wants_frame(const std::string &id);
+
+    // Последний кадр потока (BGR, уже с разметкой). Кадр копируется, исходник можно переиспользовать
+    void publish(const std::string &id, const cv::Mat &frame);
+
+private:
+    using Jpeg = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Slot
+    {
+        int clients = 0;
+        bool removed = false;
+        std::chrono::steady_clock::time_point last_publish;
+        cv::Mat pending;   // Ждет сжатия
+        Jpeg jpeg;         // Последний сжатый кадр
+        uint64_t seq = 0;  // Растет с каждым новым jpeg
+    };
+
+    PreviewConfig config;
+    int listen_fd = -1;
+    int bound_port = 0;
+    std::atomic<bool> running{false};
+    std::thread accept_thread;
+    std::thread encoder_thread;
+
+    std::mutex mutex;
+    std::condition_variable pending_cv; // Есть кадр на сжатие
+    std::condition_variable frames_cv;  // Есть новый jpeg
+    std::map<std::string, std::shared_ptr<Slot>> slots;
+
+    // Клиентские потоки отсоединены; stop() ждет, пока их счетчик не обнулится
+    std::condition_variable clients_done;
+    int active_clients = 0;
+
+    void accept_loop();
+    void encoder_loop();
+    void serve_client(int client_fd);
+    void serve_stream(int client_fd, const std::string &id, bool single);
+    void serve_index(int client_fd);
+};
@@ -2,31 +2,89 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <map>
+#include <cstdint>
+#include <string>
 #include "detector.h" // Нам нужна структура Detection
 
 struct TrackedObject
 {
-    int id;
+    int id;       // Уникален только внутри класса (у каждого класса свое пространство ID)
+    int class_id;
     cv::Point center;
     cv::Point previous_center; // Предыдущая позиция для определения направления движения
     cv::Rect box;
     int frames_since_seen; // Чтобы не удалять объект сразу, если он моргнул
 };
 
+// Трекер одного класса: жадное сопоставление ближайших центров
 class SimpleTracker
 {
 public:
-    SimpleTracker(int max_frames_missing = 5, int distance_threshold = 50);
+    SimpleTracker(int max_frames_missing = 5, int distance_threshold = 50, int class_id = 0);
 
     // Принимает сырые детекции, возвращает объекты с ID
     std::vector<TrackedObject> update(const std::vector<Detection> &detections);
 
+    // ID треков, удаленных на последнем update (трек закончился)
+    const std::vector<int> &removed_ids() const { return removed; }
+
+    size_t size() const { return objects.size(); }
+
 private:
     int next_id = 0;
     std::map<int, TrackedObject> objects; // Хранилище активных объектов
+    std::vector<int> removed;
 
     int max_frames_missing;
     int distance_threshold;
+    int class_id;
 
     float calculate_distance(cv::Point p1, cv::Point p2);
-};
\ No newline at end of file
+};
+
+// Настройки подсчета одного класса COCO
+struct ClassTrackingConfig
+{
+    int class_id = 0;
+    std::string name = "person";
+    int distance_threshold = 50; // Пиксели между центрами на соседних кадрах
+    int max_frames_missing = 5;
+};
+
+// Имя класса COCO ("person", "car", ...) или "class_<id>" для чужих моделей
+std::string coco_class_name(int class_id);
+
+// Разбирает "--classes": список через запятую, элемент = имя или номер класса
+// с необязательными порогами: "person,car:120:10" (distance_threshold, max_frames_missing).
+// Без порогов берутся значения по умолчанию для класса (машины быстрее и крупнее людей)
+bool parse_counted_classes(const std::string &spec, std::vector<ClassTrackingConfig> &classes, std::string &error);
+
+// Ключ трека, уникальный между классами: класс в старших 32 битах, ID - в младших.
+// ID в партициях растут всю жизнь потока, поэтому ключ не должен зависеть от их величины
+inline int64_t track_key(int class_id, int track_id)
+{
+    return (static_cast<int64_t>(class_id) << 32) | static_cast<uint32_t>(track_id);
+}
+
+// Трекер нескольких классов: у каждого класса своя партиция (свой SimpleTracker, ID и пороги).
+// Детекции раскладываются по партициям за один проход, поэтому сопоставление идет только
+// внутри класса - O(N*M) на класс, а не на все объекты сцены. Крупные партиции обновляются параллельно
+class MultiClassTracker
+{
+public:
+    // Пустой список = только люди (класс 0), как раньше
+    explicit MultiClassTracker(const std::vector<ClassTrackingConfig> &classes = {});
+
+    std::vector<TrackedObject> update(const std::vector<Detection> &detections);
+
+    // Треки (class_id, track_id), удаленные на последнем update
+    const std::vector<std::pair<int, int>> &removed_tracks() const { return removed; }
+
+    const std::vector<ClassTrackingConfig> &classes() const { return configs; }
+
+private:
+    std::vector<ClassTrackingConfig> configs;
+    std::vector<SimpleTracker> partitions;  // Параллельно configs
+    std::map<int, size_t> partition_index;  // class_id -> индекс партиции
+    std::vector<std::pair<int, int>> removed;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+// Компактное хранилище траекторий треков.
+//
+// Формат: append-only сегменты "<dir>/<segment_start_s>.traj", по одному на segment_seconds
+// (трек попадает в сегмент по времени своего начала). Файл = заголовок "TRJ1" + varint(segment_seconds),
+// дальше записи по одной на трек:
+//
+//   varint record_size                         - размер записи (для пропуска без декодирования)
+//   varint track_id, class_id                  - ID уникален только внутри класса
+//   varint start_ms, duration_ms, frame_us, n_points
+//   zigzag min_x, min_y, max_x, max_y          - рамка траектории (для пропуска по региону)
+//   колонки по n_points значений:
+//     frame  - varint дельты номера кадра
+//     cx, cy - zigzag varint дельты центра
+//     w, h   - zigzag varint дельты размера бокса
+//
+// При 25 Гц соседние точки отличаются на единицы пикселей, поэтому точка занимает ~5 байт.
+
+struct TrajectoryPoint
+{
+    int64_t timestamp_ms;
+    int64_t frame; // При чтении - номер кадра от начала трека
+    cv::Point center;
+    cv::Size size;
+};
+
+struct Trajectory
+{
+    int track_id;
+    int class_id = 0;
+    int64_t start_ms;
+    int64_t end_ms;
+    std::vector<TrajectoryPoint> points;
+};
+
+// Буферизует точки активных треков в памяти и дописывает трек в сегмент, когда он закончился
+class TrajectoryWriter
+{
+public:
+    TrajectoryWriter(const std::string &dir, int segment_seconds = 3600);
+    ~TrajectoryWriter(); // Дописывает все незаконченные треки
+
+    void add_point(int class_id, int track_id, int64_t frame, int64_t timestamp_ms, const cv::Rect &box);
+
+    // Трек закончился: кодируем и пишем
+    void finish_track(int class_id, int track_id);
+    void finish_all();
+
+    size_t bytes_written() const { return total_bytes; }
+    size_t points_written() const { return total_points; }
+
+private:
+    std::string dir;
+    int segment_seconds;
+
+    // Буфер активных треков; ключ (class_id, track_id) - у каждого класса свои ID
+    std::map<std::pair<int, int>, std::vector<TrajectoryPoint>> active;
+
+    FILE *file = nullptr;
+    int64_t current_segment = -1;
+
+    size_t total_bytes = 0;
+    size_t total_points = 0;
+
+    bool open_segment(int64_t segment_start_s);
+};
+
+struct TrajectoryQuery
+{
+    int64_t from_ms = 0;
+    int64_t to_ms = std::numeric_limits<int64_t>::max();
+    cv::Rect region; // Пустой = весь кадр; иначе хотя бы одна точка траектории внутри
+};
+
+// Читает сегменты через mmap и фильтрует треки по времени и региону
+class TrajectoryReader
+{
+public:
+    explicit TrajectoryReader(const std::string &dir);
+
+    std::vector<Trajectory> query(const TrajectoryQuery &q) const;
+
+private:
+    std::string dir;
+
+    void scan_segment(const std::string &path, const TrajectoryQuery &q, std::vector<Trajectory> &out) const;
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Формат выходного тензора детектора ("голова" модели)
+enum class HeadFormat
+{
+    YOLOv8,   // [B, 4 + C, A] - транспонированный, без objectness (YOLOv8 / YOLO11)
+    YOLOv5,   // [B, A, 5 + C] - построчный, с objectness
+    EndToEnd, // [B, N, 6] - x1, y1, x2, y2, score, class; NMS уже внутри модели (YOLOv10)
+};
+
+// Перевод боксов из координат входа модели в координаты кадра
+struct BoxTransform
+{
+    float x_factor;
+    float y_factor;
+    int offset_x;
+    int offset_y;
+};
+
+// Кандидаты после декодирования (до NMS)
+struct DecodedBoxes
+{
+    std::vector<cv::Rect> boxes;
+    std::vector<float> confidences;
+    std::vector<int> class_ids;
+};
+
+// Сигнатура декодера одной картинки батча.
+// num_classes нужен только общему (generic) декодеру, специализации его игнорируют.
+using DecodeFn = void (*)(const float *data, int num_rows, int num_classes, float conf_threshold,
+                          const BoxTransform &t, DecodedBoxes &out);
+
+inline void push_box(DecodedBoxes &out, float x1, float y1, float x2, float y2,
+                     float score, int class_id, const BoxTransform &t)
+{
+    int left = int(x1 * t.x_factor) + t.offset_x;
+    int top = int(y1 * t.y_factor) + t.offset_y;
+    out.boxes.push_back(cv::Rect(left, top, int((x2 - x1) * t.x_factor), int((y2 - y1) * t.y_factor)));
+    out.confidences.push_back(score);
+    out.class_ids.push_back(class_id);
+}
+
+// Декодер, специализированный по формату и числу классов.
+// NC > 0 - число классов известно на этапе компиляции (шаги в циклах константные),
+// NC == 0 - общий вариант, число классов берется из выхода модели.
+template <HeadFormat F, int NC>
+struct HeadDecoder;
+
+template <int NC>
+struct HeadDecoder<HeadFormat::YOLOv8, NC>
+{
+    // num_rows = число анкоров A. Данные лежат по рядам: [cx.., cy.., w.., h.., class0.., class1.., ...]
+    static void decode(const float *data, int num_anchors, int num_classes, float conf_threshold,
+                       const BoxTransform &t, DecodedBoxes &out)
+    {
+        const int nc = NC > 0 ? NC : num_classes;
+
+        // Идем по рядам классов, а не по анкорам: доступ к памяти подряд,
+        // и внутренний цикл векторизуется компилятором
+        thread_local std::vector<float> best_score;
+        thread_local std::vector<int> best_class;
+        best_score.assign(data + 4 * num_anchors, data + 5 * num_anchors);
+        best_class.assign(num_anchors, 0);
+
+        float *scores = best_score.data();
+        int *classes = best_class.data();
+        for (int c = 1; c < nc; c++)
+        {
+            const float *row = data + (4 + c) * num_anchors;
+            for (int i = 0; i < num_anchors; i++)
+            {
+                bool better = row[i] > scores[i];
+                scores[i] = better ? row[i] : scores[i];
+                classes[i] = better ? c : classes[i];
+            }
+        }
+
+        for (int i = 0; i < num_anchors; i++)
+        {
+            if (scores[i] <= conf_threshold)
+                continue;
+
+            float cx = data[0 * num_anchors + i];
+            float cy = data[1 * num_anchors + i];
+            float w = data[2 * num_anchors + i];
+            float h = data[3 * num_anchors + i];
+            push_box(out, cx - 0.5f * w, cy - 0.5f * h, cx + 0.5f * w, cy + 0.5f * h, scores[i], classes[i], t);
+        }
+    }
+};
+
+template <int NC>
+struct HeadDecoder<HeadFormat::YOLOv5, NC>
+{
+    // num_rows = число анкоров A. Каждая строка: [cx, cy, w, h, objectness, class0, class1, ...]
+    static void decode(const float *data, int num_anchors, int num_classes, float conf_threshold,
+                       const BoxTransform &t, DecodedBoxes &out)
+    {
+        const int nc = NC > 0 ? NC : num_classes;
+        const int stride = 5 + nc;
+
+        for (int i = 0; i < num_anchors; i++)
+        {
+            const float *row = data + i * stride;
+
+            // Итоговый score = objectness * class_score <= objectness, отсекаем сразу
+            float objectness = row[4];
+            if (objectness <= conf_threshold)
+                continue;
+
+            float max_score = row[5];
+            int max_class_id = 0;
+            for (int c = 1; c < nc; c++)
+            {
+                if (row[5 + c] > max_score)
+                {
+                    max_score = row[5 + c];
+                    max_class_id = c;
+                }
+            }
+
+            float score = objectness * max_score;
+            if (score <= conf_threshold)
+                continue;
+
+            float cx = row[0], cy = row[1], w = row[2], h = row[3];
+            push_box(out, cx - 0.5f * w, cy - 0.5f * h, cx + 0.5f * w, cy + 0.5f * h, score, max_class_id, t);
+        }
+    }
+};
+
+template <int NC>
+struct HeadDecoder<HeadFormat::EndToEnd, NC>
+{
+    // num_rows = число готовых детекций N (обычно 300). Строка: [x1, y1, x2, y2, score, class]
+    static void decode(const float *data, int num_detections, int /*num_classes*/, float conf_threshold,
+                       const BoxTransform &t, DecodedBoxes &out)
+    {
+        for (int i = 0; i < num_detections; i++)
+        {
+            const float *row = data + i * 6;
+            if (row[4] <= conf_threshold)
+                continue;
+            push_box(out, row[0], row[1], row[2], row[3], row[4], int(row[5]), t);
+        }
+    }
+};
+
+// Возвращает специализированный декодер для (формат, число классов),
+// либо общий, если под такое число классов специализации нет
+DecodeFn select_decoder(HeadFormat format, int num_classes);
+
+// Определяет формат головы по форме выхода модели (может содержать -1)
+// и числу классов из метаданных (-1, если неизвестно)
+HeadFormat detect_head_format(const std::vector<int64_t> &output_shape, int metadata_classes, bool end2end_hint);
+
+// Число классов по фактической форме выхода (-1 для EndToEnd)
+int head_num_classes(HeadFormat format, const std::vector<int64_t> &output_dims);
+
+// Число строк (анкоров / готовых детекций) по фактической форме выхода
+int head_num_rows(HeadFormat format, const std::vector<int64_t> &output_dims);
+
+// Считает классы в метаданных Ultralytics: names = "{0: 'person', 1: 'bicycle', ...}"
+int count_metadata_classes(const std::string &names);
+
+bool parse_head_format(const std::string &name, HeadFormat &format);
+const char *head_format_name(HeadFormat format);
@@ -0,0 +1,26 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+
+// Раскладка сырого кадра декодера: один канал CV_8UC1 высотой h * 3 / 2
+enum class YuvLayout
+{
+    NV12, // Плоскость Y, затем чередующиеся U/V половинного разрешения
+    I420, // Плоскость Y, затем плоскость U, затем плоскость V
+};
+
+// Размер изображения, которое хранит YUV-кадр
+inline cv::Size yuv_image_size(const cv::Mat &yuv)
+{
+    return cv::Size(yuv.cols, yuv.rows * 2 / 3);
+}
+
+// Пересэмплирует область src_rect YUV-кадра сразу во входной тензор модели:
+// планарный RGB float [3, dst_h, dst_w], значения 0..1 (как blobFromImage с 1/255 и swapRB).
+// Y - билинейно, U/V - ближайший сосед (они и так половинного разрешения), BT.601 limited range.
+// Заменяет два полнокадровых прохода (YUV->BGR в декодере и BGR->RGB+resize в blobFromImage)
+// одним проходом по пикселям тензора.
+void yuv_to_tensor(const cv::Mat &yuv, YuvLayout layout, const cv::Rect &src_rect,
+                   int dst_w, int dst_h, float *dst);
+
+// Полная конвертация в BGR - только когда кадр действительно нужен (отрисовка, запись)
+void yuv_to_bgr(const cv::Mat &yuv, YuvLayout layout, cv::Mat &bgr);
@@ -24,19 +24,41 @@ def connect_db(db_path: str):
     return sqlite3.connect(db_path)
 
 
-def show_statistics(conn):
+def show_streams(conn):
+    """List streams that have counter records (each stream is its own series)"""
+    cursor = conn.cursor()
+    cursor.execute(
+        """
+        SELECT stream_id, COUNT(*)
+        FROM people_count
+        GROUP BY stream_id
+        ORDER BY stream_id
+    """
+    )
+    records = cursor.fetchall()
+    if len(records) < 2:
+        return
+
+    print("🛰️  Streams")
+    print("=" * 50)
+    for stream_id, record_count in records:
+        print(f"{stream_id:<30} {record_count} records")
+    print()
+
+
+def show_statistics(conn, stream_id: str):
     """Show basic statistics from the database"""
     cursor = conn.cursor()
 
     # Get total records
-    cursor.execute("SELECT COUNT(*) FROM people_count")
+    cursor.execute("SELECT COUNT(*) FROM people_count WHERE stream_id = ?", (stream_id,))
     total_records = cursor.fetchone()[0]
 
     if total_records == 0:
-        print("ℹ️  Database is empty. No records found.")
+        print(f"ℹ️  No records found for stream '{stream_id}'.")
         return
 
-    print(f"📊 Database Statistics")
+    print(f"📊 Database Statistics ({stream_id})")
     print("=" * 50)
     print(f"Total records: {total_records}")
     print()
@@ -49,7 +71,9 @@ def show_statistics(conn):
             MAX(out_count) as max_out,
             AVG(in_count - out_count) as avg_occupancy
         FROM people_count
-    """
+        WHERE stream_id = ?
+    """,
+        (stream_id,),
     )
     max_in, max_out, avg_occupancy = cursor.fetchone()
 
@@ -60,17 +84,18 @@ def show_statistics(conn):
     print()
 
 
-def show_recent_records(conn, limit: int = 10):
+def show_recent_records(conn, stream_id: str, limit: int = 10):
     """Show the most recent records"""
     cursor = conn.cursor()
     cursor.execute(
         """
         SELECT id, timestamp, in_count, out_count
         FROM people_count 
+        WHERE stream_id = ?
         ORDER BY timestamp DESC 
         LIMIT ?
     """,
-        (limit,),
+        (stream_id, limit),
     )
 
     records = cursor.fetchall()
@@ -91,7 +116,7 @@ def show_recent_records(conn, limit: int = 10):
     print()
 
 
-def show_daily_summary(conn):
+def show_daily_summary(conn, stream_id: str):
     """Show summary grouped by date"""
     cursor = conn.cursor()
     cursor.execute(
@@ -103,9 +128,11 @@ def show_daily_summary(conn):
             MAX(out_count) as total_out,
             AVG(in_count - out_count) as avg_occupancy
         FROM people_count
+        WHERE stream_id = ?
         GROUP BY DATE(timestamp)
         ORDER BY date DESC
-    """
+    """,
+        (stream_id,),
     )
 
     records = cursor.fetchall()
@@ -130,16 +157,18 @@ def show_daily_summary(conn):
 def export_to_csv(conn, output_file: str = "export.csv"):
     """Export all data to CSV file"""
     cursor = conn.cursor()
-    cursor.execute("SELECT * FROM people_count ORDER BY timestamp")
+    cursor.execute(
+        "SELECT id, timestamp, stream_id, in_count, out_count FROM people_count ORDER BY timestamp"
+    )
 
     with open(output_file, "w") as f:
         # Write header
-        f.write("id,timestamp,in_count,out_count,occupancy\n")
+        f.write("id,timestamp,stream_id,in_count,out_count,occupancy\n")
 
         # Write data
         for row in cursor.fetchall():
-            occupancy = row[2] - row[3]  # in_count - out_count
-            f.write(f"{row[0]},{row[1]},{row[2]},{row[3]},{occupancy}\n")
+            occupancy = row[3] - row[4]  # in_count - out_count
+            f.write(f"{row[0]},{row[1]},{row[2]},{row[3]},{row[4]},{occupancy}\n")
 
     print(f"✅ Data exported to: {output_file}")
 
@@ -165,6 +194,11 @@ def main():
         default="export.csv",
         help="CSV export filename (default: export.csv)",
     )
+    parser.add_argument(
+        "--stream",
+        default="default",
+        help="Stream to analyze (people_count.stream_id, default: default)",
+    )
 
     args = parser.parse_args()
 
@@ -182,9 +216,10 @@ def main():
 
     try:
         # Show various statistics
-        show_statistics(conn)
-        show_recent_records(conn, limit=10)
-        show_daily_summary(conn)
+        show_streams(conn)
+        show_statistics(conn, args.stream)
+        show_recent_records(conn, args.stream, limit=10)
+        show_daily_summary(conn, args.stream)
 
         # Export to CSV
         if args.export:
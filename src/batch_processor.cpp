@@ -0,0 +1,364 @@
+#include "batch_processor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Короче куска нет смысла: каждый кусок - свой VideoCapture, перемотка и разогрев трекера
+static const double kMinChunkSeconds = 60.0;
+
+static bool is_video_file(const fs::path &path)
+{
+    string ext = path.extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".mp4" || ext == ".avi" || ext == ".mkv" || ext == ".mov" || ext == ".ts";
+}
+
+static vector<string> collect_files(const string &input)
+{
+    vector<string> files;
+    error_code ec;
+    if (fs::is_directory(input, ec))
+    {
+        for (const auto &entry : fs::directory_iterator(input, ec))
+        {
+            if (entry.is_regular_file() && is_video_file(entry.path()))
+                files.push_back(entry.path().string());
+        }
+        sort(files.begin(), files.end());
+    }
+    else if (fs::exists(input, ec))
+    {
+        files.push_back(input);
+    }
+    return files;
+}
+
+static string stream_name(const string &file)
+{
+    return fs::path(file).filename().string();
+}
+
+BatchProcessor::BatchProcessor(const BatchConfig &config) : config(config) {}
+
+vector<ChunkResult> BatchProcessor::plan_chunks(const vector<string> &files) const
+{
+    vector<ChunkResult> chunks;
+    for (const auto &file : files)
+    {
+        cv::VideoCapture cap(file);
+        if (!cap.isOpened())
+        {
+            cerr << "⚠️  Skipping (cannot open): " << file << endl;
+            continue;
+        }
+
+        double fps = cap.get(cv::CAP_PROP_FPS);
+        if (fps <= 0)
+            fps = 25.0; // Fallback FPS
+        int64_t total = static_cast<int64_t>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+        int64_t chunk_frames = max<int64_t>(1, llround(config.chunk_seconds * fps));
+
+        // Длина неизвестна (битый индекс) - обрабатываем файл одним куском
+        if (total <= 0)
+        {
+            ChunkResult chunk;
+            chunk.file = file;
+            chunk.end_frame = numeric_limits<int64_t>::max();
+            chunk.fps = fps;
+            chunks.push_back(chunk);
+            continue;
+        }
+
+        int index = 0;
+        for (int64_t start = 0; start < total; start += chunk_frames)
+        {
+            ChunkResult chunk;
+            chunk.file = file;
+            chunk.index = index++;
+            chunk.start_frame = start;
+            chunk.end_frame = total - start > chunk_frames ? start + chunk_frames : total;
+            chunk.fps = fps;
+            chunks.push_back(chunk);
+        }
+    }
+    return chunks;
+}
+
+void BatchProcessor::process_chunk(ChunkResult &chunk, YOLODetector &detector) const
+{
+    auto started = chrono::steady_clock::now();
+
+    StreamConfig stream_config = config.stream;
+    stream_config.id = stream_name(chunk.file);
+    stream_config.source = chunk.file;
+    stream_config.loop = false;
+
+    CountingStream stream(stream_config);
+    if (!stream.open())
+        return;
+
+    // Начинаем раньше номинального начала, чтобы трекер набрал историю
+    int64_t overlap = llround(config.overlap_seconds * chunk.fps);
+    int64_t warmup_start = max<int64_t>(0, chunk.start_frame - overlap);
+    if (warmup_start > 0 && !stream.seek(warmup_start))
+    {
+        cerr << "❌ [" << stream_config.id << "] Cannot seek to frame " << warmup_start << endl;
+        return;
+    }
+
+    cv::Mat frame;
+    while (stream.read(frame))
+    {
+        if (stream.current_frame() >= chunk.end_frame)
+            break;
+
+        stream.process(frame, detector);
+
+        for (const auto &event : stream.last_events())
+        {
+            if (event.frame < chunk.start_frame)
+            {
+                // Принадлежит предыдущему куску; ID уже помечен как засчитанный в трекере этого куска
+                chunk.warmup_events.push_back(event);
+                continue;
+            }
+            chunk.events.push_back(event);
+            if (event.is_in)
+                chunk.count_in++;
+            else
+                chunk.count_out++;
+        }
+    }
+
+    chunk.ok = true;
+    chunk.processing_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
+
+int BatchProcessor::run(const string &input, Database &db)
+{
+    if (!(config.chunk_seconds >= kMinChunkSeconds))
+    {
+        cerr << "Error: Chunk length must be at least " << kMinChunkSeconds / 60.0 << " minute(s)" << endl;
+        return 1;
+    }
+    if (!(config.overlap_seconds >= 0.0 && config.overlap_seconds < config.chunk_seconds))
+    {
+        cerr << "Error: Overlap must be >= 0 and shorter than the chunk" << endl;
+        return 1;
+    }
+
+    // Куски начинаются с перемотки, а appsink GStreamer (--yuv) перематывать не умеет
+    if (config.stream.yuv)
+    {
+        cout << "⚠️  --yuv is not supported in batch mode (chunks need seeking), using BGR capture" << endl;
+        config.stream.yuv = false;
+    }
+
+    vector<string> files = collect_files(input);
+    if (files.empty())
+    {
+        cerr << "Error: No video files found in " << input << endl;
+        return 1;
+    }
+
+    vector<ChunkResult> chunks = plan_chunks(files);
+    if (chunks.empty())
+    {
+        cerr << "Error: None of the input files could be opened" << endl;
+        return 1;
+    }
+
+    int cores = max(1u, thread::hardware_concurrency());
+    // На GPU по умолчанию один рабочий: десятки CUDA-сессий на одной карте упираются в память
+    // (и по одной откатываются на CPU). Больше - только явно через --workers
+    int workers = config.workers > 0 ? config.workers : (config.use_gpu ? 1 : cores);
+    workers = min<int>(workers, chunks.size());
+    // Ядра делим между рабочими, чтобы сессии ONNX Runtime не дрались за них
+    int threads_per_worker = max(1, cores / workers);
+
+    cout << "🗂️  Batch: " << files.size() << " file(s), " << chunks.size() << " chunk(s), "
+         << workers << " worker(s) x " << threads_per_worker << " thread(s)" << endl;
+
+    auto started = chrono::steady_clock::now();
+    atomic<size_t> next_chunk{0};
+    mutex log_mutex;
+
+    vector<thread> pool;
+    for (int w = 0; w < workers; w++)
+    {
+        pool.emplace_back([&, w]()
+                          {
+            try
+            {
+                YOLODetector detector(config.model_path, config.use_gpu, threads_per_worker);
+                HeadFormat head_format;
+                if (!config.head_name.empty() && parse_head_format(config.head_name, head_format))
+                    detector.set_head_format(head_format);
+                if (config.tiling.enabled)
+                    detector.set_tiling(config.tiling);
+
+                size_t idx;
+                while ((idx = next_chunk++) < chunks.size())
+                {
+                    ChunkResult &chunk = chunks[idx];
+                    process_chunk(chunk, detector);
+
+                    lock_guard<mutex> lock(log_mutex);
+                    cout << (chunk.ok ? "✅" : "❌") << " [worker " << w << "] " << stream_name(chunk.file)
+                         << " chunk " << chunk.index << ": IN=" << chunk.count_in << " OUT=" << chunk.count_out
+                         << " (" << fixed << setprecision(1) << chunk.processing_seconds << "s)" << endl;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                lock_guard<mutex> lock(log_mutex);
+                cerr << "❌ [worker " << w << "] " << e.what() << endl;
+            } });
+    }
+    for (auto &t : pool)
+        t.join();
+
+    double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    // Запись в БД одной транзакцией: события по кускам + итог по каждому файлу
+    db.begin_transaction();
+    for (const auto &file : files)
+    {
+        int total_in = 0, total_out = 0;
+        map<int, ClassCount> per_class;
+        bool any = false;
+        for (const auto &chunk : chunks)
+        {
+            if (chunk.file != file || !chunk.ok)
+                continue;
+            any = true;
+            for (const auto &event : chunk.events)
+            {
+                // ID треков уникальны только внутри куска - кусок пишется отдельной колонкой
+                db.insert_event(stream_name(file), event.class_id, event.track_id,
+                                event.is_in, event.frame * 1000.0 / chunk.fps, "", chunk.index);
+
+                ClassCount &counts = per_class[event.class_id];
+                counts.name = coco_class_name(event.class_id);
+                (event.is_in ? counts.in : counts.out)++;
+            }
+            total_in += chunk.count_in;
+            total_out += chunk.count_out;
+        }
+        if (any)
+        {
+            db.insert_batch_total(stream_name(file), total_in, total_out);
+            for (const auto &pair : per_class)
+                db.insert_class_log(stream_name(file), pair.first, pair.second.name, pair.second.in, pair.second.out);
+        }
+    }
+    db.commit_transaction();
+
+    print_report(chunks, wall_seconds);
+
+    bool all_ok = all_of(chunks.begin(), chunks.end(), [](const ChunkResult &c)
+                         { return c.ok; });
+    return all_ok ? 0 : 1;
+}
+
+// Сколько пересечений предыдущего куска в зоне перекрытия увидел и разогревающийся следующий кусок.
+// Расхождение означает, что трекер не успел разогреться - стоит увеличить --overlap-seconds.
+static int matched_at_boundary(const vector<CrossingEvent> &previous, const vector<CrossingEvent> &warmup, int64_t tolerance)
+{
+    vector<bool> used(warmup.size(), false);
+    int matched = 0;
+    for (const auto &p : previous)
+    {
+        for (size_t i = 0; i < warmup.size(); i++)
+        {
+            if (!used[i] && warmup[i].is_in == p.is_in && llabs(warmup[i].frame - p.frame) <= tolerance)
+            {
+                used[i] = true;
+                matched++;
+                break;
+            }
+        }
+    }
+    return matched;
+}
+
+void BatchProcessor::print_report(const vector<ChunkResult> &chunks, double wall_seconds) const
+{
+    cout << "\n--- Batch Report ---" << endl;
+
+    int grand_in = 0, grand_out = 0;
+    double video_seconds = 0.0;
+    string current_file;
+    int file_in = 0, file_out = 0;
+
+    auto flush_file = [&]()
+    {
+        if (!current_file.empty())
+            cout << "  = " << stream_name(current_file) << " total: IN=" << file_in << " OUT=" << file_out << "\n";
+    };
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const ChunkResult &c = chunks[i];
+        if (c.file != current_file)
+        {
+            flush_file();
+            current_file = c.file;
+            file_in = file_out = 0;
+            cout << "📹 " << current_file << "\n";
+        }
+
+        int64_t last_frame = c.events.empty() ? c.start_frame : c.events.back().frame;
+        double start_s = c.start_frame / c.fps;
+        double end_s = (c.end_frame == numeric_limits<int64_t>::max() ? last_frame : c.end_frame) / c.fps;
+        video_seconds += max(0.0, end_s - start_s);
+
+        cout << "  chunk " << setw(3) << c.index
+             << "  [" << fixed << setprecision(0) << setw(6) << start_s << "s - " << setw(6) << end_s << "s]"
+             << "  IN=" << setw(4) << c.count_in << "  OUT=" << setw(4) << c.count_out;
+
+        if (!c.ok)
+            cout << "  ❌ failed";
+
+        // Проверка сшивки с предыдущим куском того же файла
+        if (i > 0 && chunks[i - 1].file == c.file && chunks[i - 1].ok && c.ok)
+        {
+            int64_t overlap = llround(config.overlap_seconds * c.fps);
+            vector<CrossingEvent> previous;
+            for (const auto &e : chunks[i - 1].events)
+            {
+                if (e.frame >= c.start_frame - overlap)
+                    previous.push_back(e);
+            }
+            int matched = matched_at_boundary(previous, c.warmup_events, llround(c.fps / 2));
+            cout << "  boundary: " << matched << "/" << previous.size() << " seen in overlap";
+            if (matched < (int)previous.size())
+                cout << " ⚠️";
+        }
+        cout << "\n";
+
+        file_in += c.count_in;
+        file_out += c.count_out;
+        grand_in += c.count_in;
+        grand_out += c.count_out;
+    }
+    flush_file();
+
+    cout << "\nTotal: IN=" << grand_in << " OUT=" << grand_out << " INSIDE=" << (grand_in - grand_out) << endl;
+    cout << "Processed " << fixed << setprecision(1) << video_seconds / 3600.0 << " h of video in "
+         << wall_seconds << " s";
+    if (wall_seconds > 0)
+        cout << " (" << video_seconds / wall_seconds << "x realtime)";
+    cout << endl;
+}
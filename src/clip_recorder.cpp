@@ -0,0 +1,228 @@
+#include "clip_recorder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+ClipRecorder::ClipRecorder(const ClipConfig &config, const string &stream_id, double fps)
+    : config(config), stream_id(stream_id), fps(fps > 0 ? fps : 25.0)
+{
+    pre_frames = max(1, (int)lround(config.pre_seconds * this->fps));
+    post_frames = max(1, (int)lround(config.post_seconds * this->fps));
+    max_frames = max(pre_frames + post_frames, (int)lround(config.max_seconds * this->fps));
+    max_pending = max<size_t>(2, lround(this->fps));
+
+    stream_dir = (fs::path(config.dir) / stream_id).string();
+    error_code ec;
+    fs::create_directories(stream_dir, ec);
+    if (ec)
+        cerr << "⚠️  Cannot create clip directory " << stream_dir << ": " << ec.message() << endl;
+
+    encoder = thread(&ClipRecorder::encoder_loop, this);
+    writer = thread(&ClipRecorder::writer_loop, this);
+}
+
+ClipRecorder::~ClipRecorder()
+{
+    finish();
+}
+
+string ClipRecorder::make_path() const
+{
+    // Время на стене + номер кадра: уникально между перезапусками и внутри одной секунды
+    time_t now = time(nullptr);
+    tm local{};
+    localtime_r(&now, &local);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+    return (fs::path(stream_dir) / (string(stamp) + "_f" + to_string(pushed) + ".mp4")).string();
+}
+
+string ClipRecorder::trigger()
+{
+    // Серия: событие попало в хвост открытого клипа - продлеваем его
+    if (active && pushed < active->limit_frame)
+    {
+        active->end_frame = min(active->limit_frame, max(active->end_frame, pushed + post_frames));
+        return active->path;
+    }
+    if (active)
+        close_active();
+
+    active = make_unique<Clip>();
+    active->path = make_path();
+    active->frames.assign(ring.begin(), ring.end());
+    active->end_frame = pushed + post_frames;
+    active->limit_frame = pushed - (int64_t)ring.size() + max_frames;
+    return active->path;
+}
+
+void ClipRecorder::push(const cv::Mat &frame, Render render)
+{
+    auto slot = make_shared<FrameSlot>();
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        if (encode_queue.size() < max_pending)
+        {
+            // На цикле - только копия кадра; отрисовка и сжатие в encoder_loop()
+            encode_queue.push_back({frame.clone(), std::move(render), slot, pushed});
+            encode_cv.notify_one();
+        }
+        else if (!drop_warned)
+        {
+            drop_warned = true;
+            cerr << "⚠️  [" << stream_id << "] Clip encoder is falling behind, dropping frames" << endl;
+        }
+    }
+
+    ring.push_back(slot);
+    while ((int)ring.size() > pre_frames)
+        ring.pop_front();
+
+    if (active)
+    {
+        active->frames.push_back(slot);
+        active->last_frame = pushed;
+        if (pushed + 1 >= active->end_frame)
+            close_active();
+    }
+    pushed++;
+}
+
+void ClipRecorder::encoder_loop()
+{
+    const vector<int> params = {cv::IMWRITE_JPEG_QUALITY, config.jpeg_quality};
+
+    while (true)
+    {
+        EncodeJob job;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            encode_cv.wait(lock, [this]()
+                           { return encoder_stopping || !encode_queue.empty(); });
+            if (encode_queue.empty())
+                return; // encoder_stopping и все сжато
+            job = std::move(encode_queue.front());
+            encode_queue.pop_front();
+        }
+
+        cv::Mat view = job.render ? job.render(job.frame) : job.frame;
+        cv::Mat small;
+        if (view.cols > config.max_width)
+        {
+            double scale = (double)config.max_width / view.cols;
+            cv::resize(view, small, cv::Size(), scale, scale, cv::INTER_AREA);
+        }
+        else
+        {
+            small = view;
+        }
+
+        auto jpeg = make_shared<vector<uint8_t>>();
+        cv::imencode(".jpg", small, *jpeg, params);
+
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            job.slot->jpeg = std::move(jpeg);
+            encoded_upto = job.index + 1;
+        }
+        encoded_cv.notify_all();
+    }
+}
+
+void ClipRecorder::close_active()
+{
+    if (!active)
+        return;
+    lock_guard<mutex> lock(queue_mutex);
+    queue.push_back(std::move(active));
+    queue_cv.notify_one();
+}
+
+void ClipRecorder::finish()
+{
+    if (!writer.joinable())
+        return;
+
+    close_active();
+
+    // Сначала дожимаем очередь сжатия: пропущенные кадры больше никто не сожмет
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        encoder_stopping = true;
+    }
+    encode_cv.notify_one();
+    encoder.join();
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        encoded_upto = INT64_MAX;
+        stopping = true;
+    }
+    encoded_cv.notify_all();
+    queue_cv.notify_one();
+    writer.join();
+}
+
+void ClipRecorder::writer_loop()
+{
+    while (true)
+    {
+        unique_ptr<Clip> clip;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]()
+                          { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return; // stopping и все дописано
+            clip = std::move(queue.front());
+            queue.pop_front();
+
+            // Кадры клипа могут еще ждать сжатия
+            encoded_cv.wait(lock, [&]()
+                            { return encoded_upto > clip->last_frame; });
+        }
+        write_clip(*clip);
+    }
+}
+
+void ClipRecorder::write_clip(const Clip &clip)
+{
+    // Пропущенные кадры (сжатие не успевало) остаются без jpeg
+    auto first_it = find_if(clip.frames.begin(), clip.frames.end(), [](const SharedFrame &frame)
+                            { return frame->jpeg != nullptr; });
+    if (first_it == clip.frames.end())
+        return;
+
+    cv::Mat first = cv::imdecode(*(*first_it)->jpeg, cv::IMREAD_COLOR);
+    if (first.empty())
+        return;
+
+    int fourcc = cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    cv::VideoWriter out(clip.path, fourcc, fps, first.size());
+    if (!out.isOpened())
+    {
+        cerr << "⚠️  Cannot write clip " << clip.path << endl;
+        return;
+    }
+
+    out.write(first);
+    for (auto it = first_it + 1; it != clip.frames.end(); ++it)
+    {
+        if (!(*it)->jpeg)
+            continue;
+        cv::Mat decoded = cv::imdecode(*(*it)->jpeg, cv::IMREAD_COLOR);
+        if (!decoded.empty() && decoded.size() == first.size())
+            out.write(decoded);
+    }
+    out.release();
+
+    written++;
+    cout << "🎬 Clip saved: " << clip.path << " (" << fixed << setprecision(1)
+         << clip.frames.size() / fps << "s)" << endl;
+}
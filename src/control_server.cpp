@@ -0,0 +1,156 @@
+#include "control_server.h"
+#include <iostream>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Длиннее команда быть не может; клиент без перевода строки не должен раздувать буфер
+static const size_t kMaxLineLength = 4096;
+
+ControlServer::ControlServer(const std::string &socket_path, Handler handler)
+    : socket_path(socket_path), handler(std::move(handler)) {}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+bool ControlServer::start()
+{
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "❌ Control socket path is too long: " << socket_path << std::endl;
+        return false;
+    }
+
+    // Сокет от предыдущего запуска мешает bind. Удаляем только сокет:
+    // опечатка в --socket не должна стереть, например, базу данных
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            std::cerr << "❌ " << socket_path << " exists and is not a socket, refusing to replace it" << std::endl;
+            return false;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        std::cerr << "❌ Can't create control socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 8) < 0)
+    {
+        std::cerr << "❌ Can't listen on " << socket_path << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    running = true;
+    accept_thread = std::thread(&ControlServer::accept_loop, this);
+    std::cout << "🎛️  Control socket: " << socket_path << std::endl;
+    return true;
+}
+
+void ControlServer::stop()
+{
+    if (!running.exchange(false))
+        return;
+
+    // Потоки опрашивают running с таймаутом, поэтому просто ждем их
+    if (accept_thread.joinable())
+        accept_thread.join();
+
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+        clients_done.wait(lock, [this]
+                          { return active_clients == 0; });
+    }
+
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+}
+
+void ControlServer::accept_loop()
+{
+    while (running)
+    {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            active_clients++;
+        }
+        std::thread(&ControlServer::serve_client, this, client_fd).detach();
+    }
+}
+
+void ControlServer::serve_client(int client_fd)
+{
+    std::string buffer;
+    char chunk[512];
+
+    while (running)
+    {
+        pollfd pfd{client_fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 200);
+        if (ready == 0)
+            continue;
+        if (ready < 0)
+            break;
+
+        ssize_t n = recv(client_fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            break; // Клиент отключился
+
+        buffer.append(chunk, n);
+
+        // Обрабатываем все полные строки
+        size_t pos;
+        while ((pos = buffer.find('\n')) != std::string::npos)
+        {
+            std::string command = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+            if (!command.empty() && command.back() == '\r')
+                command.pop_back();
+            if (command.empty())
+                continue;
+
+            std::string reply = handler(command) + "\n";
+            send(client_fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        }
+
+        if (buffer.size() > kMaxLineLength)
+        {
+            std::string reply = "ERR line too long\n";
+            send(client_fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+            break;
+        }
+    }
+
+    close(client_fd);
+
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    active_clients--;
+    clients_done.notify_all();
+}
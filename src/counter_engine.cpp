@@ -0,0 +1,360 @@
+#include "counter_engine.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+CounterEngine::CounterEngine(YOLODetector &detector, Database &db)
+    : detector(detector), db(db) {}
+
+bool CounterEngine::add_stream(const StreamConfig &config, string &error)
+{
+    if (streams.count(config.id))
+    {
+        error = "stream '" + config.id + "' already exists";
+        return false;
+    }
+
+    auto stream = make_unique<CountingStream>(config);
+    if (!stream->open())
+    {
+        error = "could not open source '" + config.source + "'";
+        return false;
+    }
+
+    attach_stream(move(stream));
+    return true;
+}
+
+void CounterEngine::attach_stream(unique_ptr<CountingStream> stream)
+{
+    const string id = stream->id();
+    if (!trajectory_dir.empty())
+        stream->enable_trajectories(trajectory_dir + "/" + id);
+    if (!clip_config.dir.empty())
+        clips[id] = make_unique<ClipRecorder>(clip_config, id, stream->source_fps());
+    if (preview)
+        preview->add_stream(id);
+    start_capture(*stream);
+
+    cout << "➕ Stream added: " << id << " (" << stream->get_config().source << ")" << endl;
+    streams[id] = move(stream);
+}
+
+void CounterEngine::start_capture(CountingStream &stream)
+{
+    stream.start_capture([this]
+                         {
+                             frames_ready = true;
+                             queue_cv.notify_one();
+                         });
+}
+
+void CounterEngine::run_helper(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        active_helpers++;
+    }
+    thread([this, task = move(task)]
+           {
+               task();
+               lock_guard<mutex> lock(queue_mutex);
+               active_helpers--;
+               helpers_done.notify_all();
+           })
+        .detach();
+}
+
+void CounterEngine::start_open(const StreamConfig &config, shared_ptr<promise<string>> reply)
+{
+    opening.insert(config.id);
+    run_helper([this, config, reply]
+               {
+                   auto stream = make_unique<CountingStream>(config);
+                   if (!stream->open())
+                       stream.reset();
+
+                   lock_guard<mutex> lock(queue_mutex);
+                   opened.push_back({config.id, move(stream), reply});
+                   queue_cv.notify_one();
+               });
+}
+
+string CounterEngine::submit(const string &command)
+{
+    if (!running)
+        return "ERR engine is shutting down";
+
+    future<string> reply;
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        queue.emplace_back();
+        queue.back().line = command;
+        reply = queue.back().reply.get_future();
+    }
+    queue_cv.notify_one();
+
+    // Команда применяется между кадрами; при добавлении RTSP-потока открытие может занять время
+    if (reply.wait_for(chrono::seconds(30)) != future_status::ready)
+        return "ERR timeout";
+    return reply.get();
+}
+
+void CounterEngine::process_commands()
+{
+    deque<PendingCommand> pending;
+    deque<OpenedStream> ready;
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        pending.swap(queue);
+        ready.swap(opened);
+    }
+
+    // Открытые во вспомогательных потоках источники вставляются между кадрами
+    for (auto &item : ready)
+    {
+        opening.erase(item.id);
+        if (!item.stream)
+        {
+            string reply = "ERR could not open source";
+            cout << "🎛️  add " << item.id << " -> " << reply << endl;
+            item.reply->set_value(reply);
+            continue;
+        }
+
+        attach_stream(move(item.stream));
+        item.reply->set_value("OK");
+    }
+
+    for (auto &cmd : pending)
+    {
+        istringstream in(cmd.line);
+        string command, id, source, flag;
+        in >> command >> id >> source >> flag;
+
+        // Открытие источника может занять секунды - ответ придет, когда поток будет вставлен
+        if (command == "add" && !id.empty() && !source.empty() && !streams.count(id) && !opening.count(id))
+        {
+            StreamConfig config;
+            config.id = id;
+            config.source = source;
+            config.loop = (flag == "loop");
+            config.classes = counted_classes;
+            cout << "🎛️  " << cmd.line << " -> opening" << endl;
+            start_open(config, make_shared<promise<string>>(move(cmd.reply)));
+            continue;
+        }
+
+        string reply = apply(cmd.line);
+        cout << "🎛️  " << cmd.line << " -> " << reply << endl;
+        cmd.reply.set_value(reply);
+    }
+}
+
+string CounterEngine::apply(const string &line)
+{
+    istringstream in(line);
+    string command, id;
+    in >> command >> id;
+
+    if (command == "stats")
+        return stats(id);
+
+    if (command == "shutdown")
+    {
+        running = false;
+        return "OK shutting down";
+    }
+
+    // Корректная команда add уходит в start_open(); сюда попадают только ошибки
+    if (command == "add")
+    {
+        string source;
+        in >> source;
+        if (id.empty() || source.empty())
+            return "ERR usage: add <id> <source> [loop]";
+        if (opening.count(id))
+            return "ERR stream '" + id + "' is already being opened";
+        return "ERR stream '" + id + "' already exists";
+    }
+
+    if (id.empty())
+        return "ERR usage: " + command + " <id> ...";
+
+    auto it = streams.find(id);
+    if (it == streams.end())
+        return "ERR unknown stream '" + id + "'";
+    CountingStream &stream = *it->second;
+
+    if (command == "remove")
+    {
+        if (preview)
+            preview->remove_stream(id);
+        // Остановка захвата ждет чтения источника, а клип дописывается - не в цикле подсчета
+        shared_ptr<CountingStream> removed = move(it->second);
+        shared_ptr<ClipRecorder> removed_clips;
+        auto clip_it = clips.find(id);
+        if (clip_it != clips.end())
+        {
+            removed_clips = move(clip_it->second);
+            clips.erase(clip_it);
+        }
+        streams.erase(it);
+        run_helper([removed = move(removed), removed_clips = move(removed_clips)]() mutable
+                   {
+                       if (removed_clips)
+                           removed_clips->finish();
+                       removed_clips.reset();
+                       removed.reset();
+                   });
+        return "OK";
+    }
+    if (command == "pause" || command == "resume")
+    {
+        stream.set_paused(command == "pause");
+        return "OK";
+    }
+    if (command == "line")
+    {
+        int y;
+        if (!(in >> y))
+            return "ERR usage: line <id> <y>";
+        stream.set_line_y(y);
+        return "OK";
+    }
+    if (command == "conf")
+    {
+        float threshold;
+        if (!(in >> threshold) || threshold <= 0.0f || threshold >= 1.0f)
+            return "ERR usage: conf <id> <threshold in (0, 1)>";
+        stream.set_conf_threshold(threshold);
+        return "OK";
+    }
+
+    return "ERR unknown command '" + command + "'";
+}
+
+string CounterEngine::stats(const string &id) const
+{
+    ostringstream out;
+    out << "OK";
+    for (const auto &pair : streams)
+    {
+        if (!id.empty() && pair.first != id)
+            continue;
+
+        const CountingStream &s = *pair.second;
+        const char *state = s.is_finished() ? "finished" : (s.is_paused() ? "paused" : "running");
+        out << " " << s.id() << ": in=" << s.count_in() << " out=" << s.count_out()
+            << " inside=" << (s.count_in() - s.count_out());
+        if (s.class_counts().size() > 1)
+        {
+            for (const auto &c : s.class_counts())
+                out << " " << c.second.name << "=" << c.second.in << "/" << c.second.out;
+        }
+        out << " line=" << s.line_y()
+            << " conf=" << fixed << setprecision(2) << s.get_config().conf_threshold
+            << " fps=" << setprecision(1) << s.fps().getAverageFPS()
+            << " frames=" << s.fps().getFrameCount()
+            << " state=" << state << ";";
+    }
+    return out.str();
+}
+
+void CounterEngine::run()
+{
+    cout << "🛰️  Daemon started, " << streams.size() << " stream(s)" << endl;
+
+    cv::Mat frame;
+    while (running)
+    {
+        // Все изменения конфигурации - строго между кадрами
+        process_commands();
+
+        bool any_processed = false;
+        for (auto &pair : streams)
+        {
+            CountingStream &stream = *pair.second;
+            if (stream.is_paused() || stream.is_finished())
+                continue;
+
+            // Кадра еще нет - не ждем этот поток, обрабатываем остальные
+            if (!stream.take_frame(frame))
+            {
+                if (stream.is_finished())
+                    cout << "✅ [" << stream.id() << "] Stream finished" << endl;
+                continue;
+            }
+            any_processed = true;
+
+            auto start = chrono::high_resolution_clock::now();
+            stream.process(frame, detector);
+            auto end = chrono::high_resolution_clock::now();
+            stream.fps().addSample(static_cast<float>(chrono::duration_cast<chrono::milliseconds>(end - start).count()));
+
+            auto clip_it = clips.find(stream.id());
+            ClipRecorder *clip = clip_it != clips.end() ? clip_it->second.get() : nullptr;
+
+            for (const auto &event : stream.last_events())
+            {
+                string clip_path = clip ? clip->trigger() : string();
+                db.insert_event(stream.id(), event.class_id, event.track_id, event.is_in,
+                                event.frame * 1000.0 / stream.source_fps(), clip_path);
+            }
+            if (stream.take_count_update())
+            {
+                db.insert_log(stream.count_in(), stream.count_out(), stream.id());
+                for (const auto &pair : stream.class_counts())
+                    db.insert_class_log(stream.id(), pair.first, pair.second.name, pair.second.in, pair.second.out);
+                cout << "📦 [" << stream.id() << "] Data saved to DB: IN=" << stream.count_in()
+                     << " OUT=" << stream.count_out() << endl;
+            }
+
+            // Разметка и BGR - только когда превью этого потока кто-то смотрит
+            cv::Mat view;
+            if (preview && preview->wants_frame(stream.id()))
+            {
+                view = stream.to_bgr(frame);
+                stream.annotate(view);
+                preview->publish(stream.id(), view);
+            }
+
+            // Клипу - готовый view или сырой кадр со снимком разметки (рисуется в потоке клипов)
+            if (clip && !view.empty())
+            {
+                clip->push(view);
+            }
+            else if (clip)
+            {
+                clip->push(frame, [overlay = stream.overlay()](const cv::Mat &raw)
+                           { return CountingStream::render(raw, overlay); });
+            }
+        }
+
+        // Ни одного нового кадра - ждем кадр или команду, не крутя цикл впустую
+        if (!any_processed)
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            queue_cv.wait_for(lock, chrono::milliseconds(200), [this]
+                              { return !queue.empty() || !opened.empty() || !running || frames_ready.exchange(false); });
+        }
+    }
+
+    // Отвечаем тем, кто успел поставить команду во время остановки
+    unique_lock<mutex> lock(queue_mutex);
+    for (auto &cmd : queue)
+        cmd.reply.set_value("ERR engine is shutting down");
+    queue.clear();
+
+    // Источники, которые еще открываются, и удаляемые потоки держат this
+    helpers_done.wait(lock, [this]
+                      { return active_helpers == 0; });
+    for (auto &item : opened)
+        item.reply->set_value("ERR engine is shutting down");
+    opened.clear();
+
+    cout << "🛑 Daemon stopped" << endl;
+}
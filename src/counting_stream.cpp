@@ -0,0 +1,506 @@
+#include "counting_stream.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+// Очередь захваченных кадров: файл не теряет кадров (захват ждет), живой источник держит только свежие
+static const size_t kFileQueue = 4;
+static const size_t kLiveQueue = 2;
+
+// Камера (индекс) или сетевой поток; иначе - файл
+static bool is_live_source(const string &source)
+{
+    return source.find("://") != string::npos || source.find_first_not_of("0123456789") == string::npos;
+}
+
+CountingStream::CountingStream(const StreamConfig &config)
+    : config(config), tracker(config.classes), line_color(0, 255, 255)
+{
+    for (const auto &c : tracker.classes())
+        per_class[c.class_id].name = c.name;
+}
+
+CountingStream::~CountingStream()
+{
+    stop_capture();
+}
+
+bool CountingStream::open()
+{
+    if (!open_capture())
+        return false;
+
+    // Параметры источника запоминаем сразу: потом cap принадлежит потоку захвата
+    double source = cap.get(CAP_PROP_FPS);
+    fps_value = source > 0 ? source : 25.0; // Fallback FPS
+    if (yuv_mode)
+        image_size = yuv_image_size(pending_frame);
+    else
+        image_size = Size(static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH)),
+                          static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT)));
+
+    finished = false;
+    current_line_y = config.line_y >= 0 ? config.line_y : frame_size().height / 2; // Линия на середине кадра
+    return true;
+}
+
+bool CountingStream::open_capture()
+{
+    if (config.yuv && open_yuv_capture())
+        return true;
+
+    yuv_mode = false;
+    cap.open(config.source);
+    return cap.isOpened();
+}
+
+// Конвейер GStreamer, отдающий кадры декодера в YUV без перевода в BGR.
+// formats - допустимые форматы appsink. Если декодер уже выдает один из них (аппаратные - NV12,
+// программные вроде avdec_h264 - I420), videoconvert работает в passthrough и кадр не трогает
+static string yuv_pipeline(const string &source, const string &formats)
+{
+    bool is_uri = source.find("://") != string::npos;
+    string pipeline = is_uri ? "uridecodebin uri=" + source
+                             : "filesrc location=\"" + source + "\" ! decodebin";
+    pipeline += " ! videoconvert ! video/x-raw,format=" + formats + " ! appsink sync=false";
+    // Для живых источников лучше потерять кадр, чем копить задержку
+    if (is_uri)
+        pipeline += " max-buffers=2 drop=true";
+    return pipeline;
+}
+
+bool CountingStream::open_yuv_pipeline(const string &formats, Mat &first, YuvLayout &layout)
+{
+    if (!cap.open(yuv_pipeline(config.source, formats), CAP_GSTREAMER))
+        return false;
+
+    // Проверяем, что бэкенд действительно отдает плоскости, а не BGR
+    if (!cap.read(first) || first.empty() || first.type() != CV_8UC1 || first.rows % 3 != 0 || !first.isContinuous())
+    {
+        cap.release();
+        return false;
+    }
+
+    // Раскладку плоскостей узнаем по согласованному формату
+    int fourcc = static_cast<int>(cap.get(CAP_PROP_FOURCC));
+    if (fourcc == VideoWriter::fourcc('I', '4', '2', '0'))
+    {
+        layout = YuvLayout::I420;
+    }
+    else if (fourcc == VideoWriter::fourcc('N', 'V', '1', '2') || formats == "NV12")
+    {
+        layout = YuvLayout::NV12;
+    }
+    else
+    {
+        cap.release(); // Формат не распознать - раскладку угадывать нельзя
+        return false;
+    }
+    return true;
+}
+
+bool CountingStream::open_yuv_capture()
+{
+    // Сначала - формат декодера как есть; если не вышло, явно конвертируем в NV12
+    Mat first;
+    YuvLayout layout = YuvLayout::NV12;
+    if (!open_yuv_pipeline("(string){NV12,I420}", first, layout) &&
+        !open_yuv_pipeline("NV12", first, layout))
+    {
+        cerr << "⚠️ [" << config.id << "] GStreamer YUV capture unavailable, falling back to BGR" << endl;
+        return false;
+    }
+
+    yuv_mode = true;
+    yuv_layout = layout;
+    pending_frame = first;
+    Size size = yuv_image_size(first);
+    cout << "🎞️  [" << config.id << "] YUV capture: " << (layout == YuvLayout::I420 ? "I420 " : "NV12 ")
+         << size.width << "x" << size.height << endl;
+    return true;
+}
+
+Mat CountingStream::to_bgr(const Mat &frame) const
+{
+    if (!yuv_mode)
+        return frame;
+    Mat bgr;
+    yuv_to_bgr(frame, yuv_layout, bgr);
+    return bgr;
+}
+
+double CountingStream::source_fps() const
+{
+    return fps_value;
+}
+
+int64_t CountingStream::frame_count() const
+{
+    return static_cast<int64_t>(cap.get(CAP_PROP_FRAME_COUNT));
+}
+
+bool CountingStream::seek(int64_t frame)
+{
+    pending_frame.release();
+    if (!cap.set(CAP_PROP_POS_FRAMES, static_cast<double>(frame)))
+        return false;
+    read_index = frame_index = frame - 1;
+    return true;
+}
+
+Size CountingStream::frame_size() const
+{
+    return image_size;
+}
+
+void CountingStream::enable_trajectories(const string &dir)
+{
+    trajectories = make_unique<TrajectoryWriter>(dir);
+    cout << "🧭 [" << config.id << "] Trajectories: " << dir << endl;
+}
+
+bool CountingStream::read(Mat &frame)
+{
+    bool restart = false;
+    if (!read_next(frame, restart))
+    {
+        finished = true;
+        return false;
+    }
+    frame_index = read_index;
+    if (restart)
+        restarted = true; // Треки и траектории сбрасываются перед следующим process()
+    return true;
+}
+
+bool CountingStream::read_next(Mat &frame, bool &restart)
+{
+    read_index++;
+    if (!pending_frame.empty())
+    {
+        frame = pending_frame;
+        pending_frame.release();
+        return true;
+    }
+
+    cap >> frame;
+    // If video ended - restart from beginning (if loop enabled) or exit
+    if (frame.empty())
+    {
+        if (config.loop)
+        {
+            cout << "🔁 [" << config.id << "] Video ended, restarting from beginning..." << endl;
+            // Конвейер GStreamer не всегда умеет перематывать - тогда открываем заново
+            if (!cap.set(CAP_PROP_POS_FRAMES, 0))
+                open_capture();
+            read_index = 0;
+            restart = true;
+            if (!pending_frame.empty())
+            {
+                frame = pending_frame;
+                pending_frame.release();
+            }
+            else
+            {
+                cap >> frame;
+            }
+            if (frame.empty())
+            {
+                cerr << "❌ [" << config.id << "] Error: Cannot restart video" << endl;
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CountingStream::start_capture(function<void()> callback)
+{
+    on_frame = move(callback);
+    capture_thread = thread(&CountingStream::capture_loop, this);
+}
+
+void CountingStream::capture_loop()
+{
+    bool live = is_live_source(config.source);
+
+    while (true)
+    {
+        // Новый Mat на каждый кадр: буфер предыдущего еще может лежать в очереди
+        Mat frame;
+        bool restart = false;
+        bool ok = read_next(frame, restart);
+        {
+            unique_lock<mutex> lock(capture_mutex);
+            if (capture_stop)
+                return;
+            if (!ok)
+            {
+                capture_done = true;
+            }
+            else if (live)
+            {
+                // Отстающий обработчик получает свежий кадр, а не очередь из прошлого
+                while (captured.size() >= kLiveQueue)
+                {
+                    restart |= captured.front().restarted;
+                    captured.pop_front();
+                }
+                captured.push_back({frame, read_index, restart});
+            }
+            else
+            {
+                capture_cv.wait(lock, [this]
+                                { return captured.size() < kFileQueue || capture_stop; });
+                if (capture_stop)
+                    return;
+                captured.push_back({frame, read_index, restart});
+            }
+        }
+        if (on_frame)
+            on_frame();
+        if (!ok)
+            return;
+    }
+}
+
+bool CountingStream::take_frame(Mat &frame)
+{
+    CapturedFrame item;
+    {
+        lock_guard<mutex> lock(capture_mutex);
+        if (captured.empty())
+        {
+            if (capture_done)
+                finished = true;
+            return false;
+        }
+        item = move(captured.front());
+        captured.pop_front();
+    }
+    capture_cv.notify_one();
+
+    frame = item.frame;
+    frame_index = item.index;
+    if (item.restarted)
+        restarted = true;
+    return true;
+}
+
+void CountingStream::stop_capture()
+{
+    if (!capture_thread.joinable())
+        return;
+    {
+        lock_guard<mutex> lock(capture_mutex);
+        capture_stop = true;
+    }
+    capture_cv.notify_all();
+    // Если поток висит в чтении источника, ждем его таймаута (демон удаляет потоки не в своем цикле)
+    capture_thread.join();
+}
+
+void CountingStream::reset_tracking()
+{
+    // Треки не переживают перемотку: номера кадров начались заново, и люди в кадре уже другие
+    if (trajectories)
+        trajectories->finish_all();
+    // Новый круг файла продолжает шкалу времени сразу за предыдущим
+    if (video_epoch_ms >= 0)
+        video_epoch_ms = last_point_ms + llround(1000.0 / fps_value);
+    tracker = MultiClassTracker(config.classes);
+    counted_ids.clear(); // ID в новом трекере снова начинаются с 0
+    tracked_objects.clear();
+}
+
+int64_t CountingStream::trajectory_time_ms()
+{
+    int64_t wall_ms = chrono::duration_cast<chrono::milliseconds>(
+                          chrono::system_clock::now().time_since_epoch())
+                          .count();
+    if (is_live_source(config.source))
+        return wall_ms;
+    // Позиция в файле; шкала привязана к стене в момент первой точки
+    int64_t position_ms = llround(frame_index * 1000.0 / fps_value);
+    if (video_epoch_ms < 0)
+        video_epoch_ms = wall_ms - position_ms;
+    return video_epoch_ms + position_ms;
+}
+
+void CountingStream::process(Mat &frame, YOLODetector &detector)
+{
+    if (restarted)
+    {
+        reset_tracking();
+        restarted = false;
+    }
+
+    // Линию могли передвинуть между кадрами
+    current_line_y = config.line_y >= 0 ? config.line_y : frame_size().height / 2;
+
+    // 1. Детекция (в YUV-режиме тензор собирается прямо из плоскостей)
+    auto detections = yuv_mode ? detector.detect_yuv(frame, yuv_layout, config.conf_threshold)
+                               : detector.detect(frame, config.conf_threshold);
+
+    // 2. Трекинг (превращаем просто боксы в объекты с ID)
+    tracked_objects = tracker.update(detections);
+
+    // Траектории: точки видимых в этом кадре треков, закончившиеся треки - на диск
+    if (trajectories)
+    {
+        int64_t now_ms = trajectory_time_ms();
+        last_point_ms = now_ms;
+        for (const auto &obj : tracked_objects)
+        {
+            if (obj.frames_since_seen == 0)
+                trajectories->add_point(obj.class_id, obj.id, frame_index, now_ms, obj.box);
+        }
+        for (const auto &track : tracker.removed_tracks())
+            trajectories->finish_track(track.first, track.second);
+    }
+
+    // 3. Логика двунаправленного подсчета
+    line_color = Scalar(0, 255, 255); // По умолчанию желтая
+    events.clear();
+
+    for (const auto &obj : tracked_objects)
+    {
+        int64_t key = track_key(obj.class_id, obj.id);
+        ClassCount &counts = per_class[obj.class_id];
+
+        // Логика векторного пересечения
+        // Условие 1: Сейчас ниже линии, был выше (ВХОД / DOWN)
+        if (obj.previous_center.y < current_line_y && obj.center.y >= current_line_y)
+        {
+            if (counted_ids.find(key) == counted_ids.end())
+            {
+                in_count++;
+                counts.in++;
+                counted_ids.insert(key);
+                events.push_back({obj.id, obj.class_id, true, frame_index, obj.center});
+                line_color = Scalar(0, 255, 0); // Зеленый миг
+            }
+        }
+
+        // Условие 2: Сейчас выше линии, был ниже (ВЫХОД / UP)
+        if (obj.previous_center.y > current_line_y && obj.center.y <= current_line_y)
+        {
+            if (counted_ids.find(key) == counted_ids.end())
+            {
+                out_count++;
+                counts.out++;
+                counted_ids.insert(key);
+                events.push_back({obj.id, obj.class_id, false, frame_index, obj.center});
+                line_color = Scalar(0, 0, 255); // Красный миг
+            }
+        }
+    }
+}
+
+bool CountingStream::take_count_update()
+{
+    // Пишем в базу, только если счетчик увеличился
+    int current_count = in_count + out_count;
+    if (current_count > last_saved_count)
+    {
+        last_saved_count = current_count;
+        return true;
+    }
+    return false;
+}
+
+FrameOverlay CountingStream::overlay() const
+{
+    FrameOverlay overlay;
+    overlay.yuv = yuv_mode;
+    overlay.yuv_layout = yuv_layout;
+    overlay.objects = tracked_objects;
+    overlay.line_y = current_line_y;
+    overlay.line_color = line_color;
+    overlay.in_count = in_count;
+    overlay.out_count = out_count;
+    overlay.per_class = per_class;
+    return overlay;
+}
+
+Mat CountingStream::render(const Mat &frame, const FrameOverlay &overlay)
+{
+    Mat view;
+    if (overlay.yuv)
+        yuv_to_bgr(frame, overlay.yuv_layout, view);
+    else
+        view = frame;
+    draw_overlay(view, overlay);
+    return view;
+}
+
+void CountingStream::annotate(Mat &frame) const
+{
+    draw_overlay(frame, overlay());
+}
+
+void CountingStream::draw_overlay(Mat &frame, const FrameOverlay &overlay)
+{
+    const auto &per_class = overlay.per_class;
+    int current_line_y = overlay.line_y;
+    int in_count = overlay.in_count;
+    int out_count = overlay.out_count;
+
+    bool multi_class = per_class.size() > 1;
+    for (const auto &obj : overlay.objects)
+    {
+        // Рисуем бокс и ID (при нескольких классах - с именем класса, ID у каждого класса свои)
+        string label = multi_class ? per_class.at(obj.class_id).name + " " + to_string(obj.id)
+                                   : "ID: " + to_string(obj.id);
+        rectangle(frame, obj.box, Scalar(0, 255, 0), 2);
+        putText(frame, label,
+                Point(obj.box.x, obj.box.y - 10),
+                FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
+
+        // Рисуем центральную точку
+        circle(frame, obj.center, 5, Scalar(0, 255, 0), -1);
+    }
+
+    // Рисуем линию подсчета (цвет меняется при пересечении)
+    cv::line(frame, Point(0, current_line_y), Point(frame.cols, current_line_y), overlay.line_color, 2);
+
+    // Вычисляем занятость (сколько внутри)
+    int occupancy = in_count - out_count;
+    int corrected_occupancy = std::max(0, occupancy); // Защита от отрицательных значений
+
+    // Рисуем информационную панель (+ строка на класс, если классов несколько)
+    int panel_height = 140 + (multi_class ? 30 * (int)per_class.size() : 0);
+    rectangle(frame, Point(0, 0), Point(300, panel_height), Scalar(0, 0, 0), -1);
+    putText(frame, "IN: " + to_string(in_count),
+            Point(10, 40), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 255, 0), 2);
+    putText(frame, "OUT: " + to_string(out_count),
+            Point(10, 80), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
+
+    // Показываем корректированное значение с предупреждением о дрейфе
+    Scalar occupancy_color = (occupancy < 0) ? Scalar(0, 165, 255) : Scalar(255, 255, 255);
+    string occupancy_text = "INSIDE: " + to_string(corrected_occupancy);
+    if (occupancy < 0)
+    {
+        occupancy_text += " (!" + to_string(occupancy) + ")";
+    }
+    putText(frame, occupancy_text,
+            Point(10, 120), FONT_HERSHEY_SIMPLEX, 0.8, occupancy_color, 2);
+
+    if (multi_class)
+    {
+        int y = 150;
+        for (const auto &pair : per_class)
+        {
+            putText(frame, pair.second.name + ": " + to_string(pair.second.in) + " / " + to_string(pair.second.out),
+                    Point(10, y), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(255, 255, 255), 1);
+            y += 30;
+        }
+    }
+}
@@ -34,7 +34,8 @@ void Database::init()
                       "id INTEGER PRIMARY KEY AUTOINCREMENT,"
                       "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
                       "in_count INTEGER NOT NULL,"
-                      "out_count INTEGER NOT NULL);";
+                      "out_count INTEGER NOT NULL,"
+                      "stream_id TEXT NOT NULL DEFAULT 'default');";
 
     char *errMsg = 0;
     int rc = sqlite3_exec(db, sql, 0, 0, &errMsg);
@@ -47,21 +48,199 @@ void Database::init()
     {
         std::cout << "Table initialised successfully" << std::endl;
     }
+
+    // Базы, созданные до появления режима демона, не знают про stream_id
+    add_column_if_missing("people_count", "stream_id", "TEXT NOT NULL DEFAULT 'default'");
+
+    // Журнал отдельных пересечений
+    exec("CREATE TABLE IF NOT EXISTS count_events ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
+         "stream_id TEXT NOT NULL,"
+         "track_id INTEGER NOT NULL,"
+         "direction TEXT NOT NULL,"
+         "video_ms REAL NOT NULL,"
+         "clip_path TEXT,"
+         "class_id INTEGER NOT NULL DEFAULT 0,"
+         "chunk INTEGER);");
+
+    // Клип события (--clips); NULL, если запись клипов выключена
+    add_column_if_missing("count_events", "clip_path", "TEXT");
+    // До подсчета нескольких классов все события были людьми (класс 0)
+    add_column_if_missing("count_events", "class_id", "INTEGER NOT NULL DEFAULT 0");
+    // Номер куска офлайн-режима; NULL для живых потоков
+    add_column_if_missing("count_events", "chunk", "INTEGER");
+
+    // Счетчики по классам (--classes)
+    exec("CREATE TABLE IF NOT EXISTS class_count ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
+         "stream_id TEXT NOT NULL,"
+         "class_id INTEGER NOT NULL,"
+         "class_name TEXT NOT NULL,"
+         "in_count INTEGER NOT NULL,"
+         "out_count INTEGER NOT NULL);");
+
+    // Итоги офлайн-режима по файлам: не смешиваются с живыми рядами people_count
+    exec("CREATE TABLE IF NOT EXISTS batch_totals ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
+         "stream_id TEXT NOT NULL,"
+         "in_count INTEGER NOT NULL,"
+         "out_count INTEGER NOT NULL);");
 }
 
-void Database::insert_log(int in_count, int out_count)
+void Database::exec(const char *sql)
 {
-    // В реальном коде лучше использовать Prepared Statements, чтобы избежать инъекций,
-    // но для Int это безопасно.
-    std::string sql = "INSERT INTO people_count (in_count, out_count) VALUES (" +
-                      std::to_string(in_count) + ", " + std::to_string(out_count) + ");";
-
     char *errMsg = 0;
-    int rc = sqlite3_exec(db, sql.c_str(), 0, 0, &errMsg);
+    if (sqlite3_exec(db, sql, 0, 0, &errMsg) != SQLITE_OK)
+    {
+        std::cerr << "SQL error: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+    }
+}
 
-    if (rc != SQLITE_OK)
+void Database::begin_transaction()
+{
+    exec("BEGIN TRANSACTION;");
+}
+
+void Database::commit_transaction()
+{
+    exec("COMMIT;");
+}
+
+void Database::add_column_if_missing(const std::string &table, const std::string &column, const std::string &definition)
+{
+    std::string pragma = "PRAGMA table_info(" + table + ");";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, pragma.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+        return;
+
+    bool exists = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        // Колонка 1 в table_info - имя колонки
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        if (name && column == reinterpret_cast<const char *>(name))
+        {
+            exists = true;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (exists)
+        return;
+
+    std::string sql = "ALTER TABLE " + table + " ADD COLUMN " + column + " " + definition + ";";
+    char *errMsg = 0;
+    if (sqlite3_exec(db, sql.c_str(), 0, 0, &errMsg) != SQLITE_OK)
     {
-        std::cerr << "Insert error: " << errMsg << std::endl;
+        std::cerr << "Migration error: " << errMsg << std::endl;
         sqlite3_free(errMsg);
     }
-}
\ No newline at end of file
+    else
+    {
+        std::cout << "Added column " << table << "." << column << std::endl;
+    }
+}
+
+void Database::insert_log(int in_count, int out_count, const std::string &stream_id)
+{
+    // Имя потока приходит снаружи (сокет управления), поэтому только через Prepared Statement
+    const char *sql = "INSERT INTO people_count (in_count, out_count, stream_id) VALUES (?, ?, ?);";
+
+    sqlite3_stmt *stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_int(stmt, 1, in_count);
+        sqlite3_bind_int(stmt, 2, out_count);
+        sqlite3_bind_text(stmt, 3, stream_id.c_str(), -1, SQLITE_TRANSIENT);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Insert error: " << sqlite3_errmsg(db) << std::endl;
+    }
+}
+
+void Database::insert_batch_total(const std::string &stream_id, int in_count, int out_count)
+{
+    const char *sql = "INSERT INTO batch_totals (stream_id, in_count, out_count) VALUES (?, ?, ?);";
+
+    sqlite3_stmt *stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, stream_id.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, in_count);
+        sqlite3_bind_int(stmt, 3, out_count);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Insert error: " << sqlite3_errmsg(db) << std::endl;
+    }
+}
+
+void Database::insert_class_log(const std::string &stream_id, int class_id, const std::string &class_name,
+                                int in_count, int out_count)
+{
+    const char *sql = "INSERT INTO class_count (stream_id, class_id, class_name, in_count, out_count) VALUES (?, ?, ?, ?, ?);";
+
+    sqlite3_stmt *stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, stream_id.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, class_id);
+        sqlite3_bind_text(stmt, 3, class_name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 4, in_count);
+        sqlite3_bind_int(stmt, 5, out_count);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Insert error: " << sqlite3_errmsg(db) << std::endl;
+    }
+}
+
+void Database::insert_event(const std::string &stream_id, int class_id, int track_id, bool is_in, double video_ms,
+                            const std::string &clip_path, int chunk)
+{
+    const char *sql = "INSERT INTO count_events (stream_id, track_id, direction, video_ms, clip_path, class_id, chunk) VALUES (?, ?, ?, ?, ?, ?, ?);";
+
+    sqlite3_stmt *stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, stream_id.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, track_id);
+        sqlite3_bind_text(stmt, 3, is_in ? "in" : "out", -1, SQLITE_STATIC);
+        sqlite3_bind_double(stmt, 4, video_ms);
+        if (clip_path.empty())
+            sqlite3_bind_null(stmt, 5);
+        else
+            sqlite3_bind_text(stmt, 5, clip_path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 6, class_id);
+        if (chunk < 0)
+            sqlite3_bind_null(stmt, 7);
+        else
+            sqlite3_bind_int(stmt, 7, chunk);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "Insert error: " << sqlite3_errmsg(db) << std::endl;
+    }
+}
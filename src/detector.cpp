@@ -1,16 +1,20 @@
 #include "detector.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 // Используем пространство имен для удобства
 using namespace cv;
 using namespace std;
 using namespace Ort;
 
-YOLODetector::YOLODetector(const std::string &model_path, bool use_cuda)
+YOLODetector::YOLODetector(const std::string &model_path, bool use_cuda, int intra_op_threads)
 {
     // 1. Настройка окружения
     env = Env(ORT_LOGGING_LEVEL_WARNING, "YOLODetector");
     session_options = SessionOptions();
+    if (intra_op_threads > 0)
+        session_options.SetIntraOpNumThreads(intra_op_threads);
 
     // 2. Подключение CUDA (если есть)
     bool cuda_enabled = false;
@@ -56,6 +60,8 @@ YOLODetector::YOLODetector(const std::string &model_path, bool use_cuda)
 
             // Пересоздаем session_options без CUDA
             session_options = SessionOptions();
+            if (intra_op_threads > 0)
+                session_options.SetIntraOpNumThreads(intra_op_threads);
             session = Session(env, model_path.c_str(), session_options);
             cout << "✅ Model loaded with CPU inference (fallback)." << endl;
         }
@@ -86,6 +92,9 @@ YOLODetector::YOLODetector(const std::string &model_path, bool use_cuda)
     auto input_tensor_info = input_type_info.GetTensorTypeAndShapeInfo();
     input_shape = input_tensor_info.GetShape();
 
+    // Динамический батч позволяет прогонять все тайлы одним вызовом Run
+    dynamic_batch = !input_shape.empty() && input_shape[0] == -1;
+
     // Если размер динамический (-1), фиксируем его
     for (size_t i = 0; i < input_shape.size(); i++)
     {
@@ -101,120 +110,372 @@ YOLODetector::YOLODetector(const std::string &model_path, bool use_cuda)
     }
 
     cout << "Model loaded: Input shape [" << input_shape[2] << "x" << input_shape[3] << "]" << endl;
+
+    // 5. Выбор декодера по метаданным и форме выхода
+    auto output_shape = session.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+
+    // Форма выхода печатается один раз здесь, а не на каждом кадре (-1 = динамическая ось)
+    cout << "Output shape: [";
+    for (size_t i = 0; i < output_shape.size(); i++)
+    {
+        cout << output_shape[i];
+        if (i < output_shape.size() - 1)
+            cout << ", ";
+    }
+    cout << "]" << endl;
+    auto metadata = session.GetModelMetadata();
+    int metadata_classes = -1;
+    bool end2end = false;
+    try
+    {
+        auto names = metadata.LookupCustomMetadataMapAllocated("names", allocator);
+        if (names)
+            metadata_classes = count_metadata_classes(names.get());
+        auto e2e = metadata.LookupCustomMetadataMapAllocated("end2end", allocator);
+        end2end = e2e && string(e2e.get()) == "True";
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "⚠️ Failed to read model metadata: " << e.what() << endl;
+    }
+
+    head = detect_head_format(output_shape, metadata_classes, end2end);
+    head_classes = head_num_classes(head, output_shape);
+    if (head_classes < 0)
+        head_classes = metadata_classes;
+    decoder = select_decoder(head, head_classes);
+
+    cout << "Output head: " << head_format_name(head);
+    if (head_classes > 0)
+        cout << ", " << head_classes << " classes";
+    cout << endl;
 }
 
-vector<Detection> YOLODetector::detect(Mat &image, float conf_threshold)
+void YOLODetector::set_head_format(HeadFormat format)
 {
-    vector<Detection> detections;
-
-    // 1. Подготовка изображения (Preprocess)
-    // Цель: [1, 3, 640, 640] float32 tensor
-    int input_w = input_shape[3];
-    int input_h = input_shape[2];
+    head = format;
+    auto output_shape = session.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    head_classes = head_num_classes(head, output_shape);
+    decoder = select_decoder(head, head_classes);
+    cout << "Output head (forced): " << head_format_name(head) << endl;
+}
 
-    Mat blob;
-    // blobFromImage делает: Resize, BGR->RGB, Normalize (1/255), HWC->CHW
-    cv::dnn::blobFromImage(image, blob, 1.0 / 255.0, Size(input_w, input_h), Scalar(), true, false);
+vector<Ort::Value> YOLODetector::run(float *data, int64_t batch_size)
+{
+    vector<int64_t> shape = input_shape;
+    shape[0] = batch_size;
 
-    // 2. Создание тензора
     // Данные в blob уже лежат плоско (contiguous), можно передавать в ONNX Runtime
-    size_t input_tensor_size = input_shape[0] * input_shape[1] * input_shape[2] * input_shape[3];
+    size_t input_tensor_size = batch_size * shape[1] * shape[2] * shape[3];
     Value input_tensor = Value::CreateTensor<float>(
         MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault),
-        (float *)blob.data, input_tensor_size, input_shape.data(), input_shape.size());
+        data, input_tensor_size, shape.data(), shape.size());
 
-    // 3. Инференс (Run) 🚀
-    auto output_tensors = session.Run(
+    return session.Run(
         RunOptions{nullptr},
         input_names.data(), &input_tensor, 1,
         output_names.data(), 1);
+}
+
+void YOLODetector::decode(const float *raw_output, const vector<int64_t> &output_dims, float conf_threshold,
+                          const Rect &view, vector<Detection> &candidates) const
+{
+    int input_w = input_shape[3];
+    int input_h = input_shape[2];
+
+    // Считаем коэффициент масштабирования, чтобы вернуть боксы к размеру оригинала
+    BoxTransform transform;
+    transform.x_factor = (float)view.width / input_w;
+    transform.y_factor = (float)view.height / input_h;
+    transform.offset_x = view.x;
+    transform.offset_y = view.y;
+
+    // Если фактическое число классов не совпало с тем, под которое выбран
+    // специализированный декодер (динамическая форма, нет метаданных) - берем общий
+    int num_classes = head_num_classes(head, output_dims);
+    int num_rows = head_num_rows(head, output_dims);
+    DecodeFn decode_fn = decoder;
+    if (head != HeadFormat::EndToEnd && num_classes != head_classes)
+        decode_fn = select_decoder(head, 0);
+
+    // Вектора для NMS (Non-Maximum Suppression)
+    DecodedBoxes decoded;
+    decode_fn(raw_output, num_rows, num_classes, conf_threshold, transform, decoded);
+
+    // NMS (Убираем дубликаты). End-to-end модели уже сделали это внутри графа
+    vector<int> nms_result;
+    if (head == HeadFormat::EndToEnd)
+    {
+        nms_result.resize(decoded.boxes.size());
+        for (size_t i = 0; i < nms_result.size(); i++)
+            nms_result[i] = (int)i;
+    }
+    else
+    {
+        cv::dnn::NMSBoxes(decoded.boxes, decoded.confidences, conf_threshold, 0.45, nms_result);
+    }
+
+    for (int idx : nms_result)
+    {
+        Detection result;
+        result.class_id = decoded.class_ids[idx];
+        result.confidence = decoded.confidences[idx];
+        result.box = decoded.boxes[idx];
+        candidates.push_back(result);
+    }
+}
+
+void YOLODetector::make_blob(const Mat &image, const YuvLayout *yuv_layout,
+                             const vector<Rect> &views, Mat &blob) const
+{
+    int input_w = input_shape[3];
+    int input_h = input_shape[2];
+
+    if (yuv_layout)
+    {
+        // Каждая область сразу пересэмплируется из плоскостей Y/UV в свой кусок тензора
+        int sizes[] = {(int)views.size(), 3, input_h, input_w};
+        blob.create(4, sizes, CV_32F);
+        size_t image_size = 3 * input_w * input_h;
+        for (size_t i = 0; i < views.size(); i++)
+            yuv_to_tensor(image, *yuv_layout, views[i], input_w, input_h, blob.ptr<float>() + i * image_size);
+        return;
+    }
+
+    // blobFromImage делает: Resize, BGR->RGB, Normalize (1/255), HWC->CHW
+    if (views.size() == 1 && views[0] == Rect(0, 0, image.cols, image.rows))
+    {
+        cv::dnn::blobFromImage(image, blob, 1.0 / 255.0, Size(input_w, input_h), Scalar(), true, false);
+        return;
+    }
+
+    vector<Mat> crops;
+    crops.reserve(views.size());
+    for (const auto &view : views)
+        crops.push_back(image(view));
+    cv::dnn::blobFromImages(crops, blob, 1.0 / 255.0, Size(input_w, input_h), Scalar(), true, false);
+}
+
+vector<Detection> YOLODetector::detect(Mat &image, float conf_threshold)
+{
+    return detect_frame(image, nullptr, conf_threshold);
+}
+
+vector<Detection> YOLODetector::detect_yuv(const Mat &yuv, YuvLayout layout, float conf_threshold)
+{
+    return detect_frame(yuv, &layout, conf_threshold);
+}
+
+vector<Detection> YOLODetector::detect_frame(const Mat &image, const YuvLayout *yuv_layout, float conf_threshold)
+{
+    if (tiling_config.enabled)
+        return detect_tiled(image, yuv_layout, conf_threshold);
+
+    vector<Detection> detections;
+    Size frame_size = yuv_layout ? yuv_image_size(image) : image.size();
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    // 1. Подготовка изображения (Preprocess)
+    // Цель: [1, 3, 640, 640] float32 tensor
+    Mat blob;
+    make_blob(image, yuv_layout, {full_frame}, blob);
+
+    // 2-3. Создание тензора и инференс (Run) 🚀
+    auto output_tensors = run((float *)blob.data, 1);
 
     // 4. Разбор ответа (Postprocess)
     // YOLOv8 Output shape: [1, 84, 8400] -> [Batch, (4 coords + 80 classes), NumAnchors]
+    // YOLOv5: [1, 25200, 85], end-to-end (YOLOv10): [1, 300, 6]
     float *raw_output = output_tensors[0].GetTensorMutableData<float>();
 
     // Получаем размеры выхода
     auto output_info = output_tensors[0].GetTensorTypeAndShapeInfo();
     auto output_dims = output_info.GetShape(); // [1, 84, 8400]
 
-    // Debug: Print output shape
-    cout << "Output shape: [";
-    for (size_t i = 0; i < output_dims.size(); i++)
-    {
-        cout << output_dims[i];
-        if (i < output_dims.size() - 1)
-            cout << ", ";
-    }
-    cout << "]" << endl;
+    // 5. Декодирование + NMS (формат выбран при загрузке модели)
+    decode(raw_output, output_dims, conf_threshold, full_frame, detections);
 
-    int num_classes = output_dims[1] - 4; // 84 - 4 = 80
-    int num_anchors = output_dims[2];     // 8400
+    return detections;
+}
 
-    // Вектора для NMS (Non-Maximum Suppression)
-    vector<int> class_ids;
-    vector<float> confidences;
-    vector<Rect> boxes;
+void YOLODetector::set_tiling(const TilingConfig &config)
+{
+    tiling_config = config;
+    tiling_config.cols = std::max(1, config.cols);
+    tiling_config.rows = std::max(1, config.rows);
+    tiling_config.overlap = std::clamp(config.overlap, 0.0f, 0.9f);
 
-    // Считаем коэффициент масштабирования, чтобы вернуть боксы к размеру оригинала
-    float x_factor = (float)image.cols / input_w;
-    float y_factor = (float)image.rows / input_h;
+    if (tiling_config.enabled && !dynamic_batch)
+    {
+        cout << "⚠️ Model has a fixed batch size, tiles will be run one by one." << endl;
+        cout << "   Re-export with dynamic batch (python/convert.py --dynamic) for batched tiles." << endl;
+    }
+}
 
-    // YOLOv8 output is transposed compared to v5/v7 usually.
-    // It's [Channels, Anchors]. We loop through anchors (columns).
+vector<Rect> YOLODetector::make_tiles(const Size &frame_size) const
+{
+    Rect frame_rect(0, 0, frame_size.width, frame_size.height);
+    Rect area = tiling_config.region.area() > 0 ? (tiling_config.region & frame_rect) : frame_rect;
+    if (area.area() <= 0)
+        area = frame_rect;
+
+    int cols = tiling_config.cols;
+    int rows = tiling_config.rows;
+    float overlap = tiling_config.overlap;
+
+    // Размер тайла подбираем так, чтобы cols тайлов с перекрытием overlap покрыли всю область
+    int tile_w = (int)std::ceil(area.width / (cols - (cols - 1) * overlap));
+    int tile_h = (int)std::ceil(area.height / (rows - (rows - 1) * overlap));
+    float step_x = cols > 1 ? (float)(area.width - tile_w) / (cols - 1) : 0.0f;
+    float step_y = rows > 1 ? (float)(area.height - tile_h) / (rows - 1) : 0.0f;
+
+    vector<Rect> tiles;
+    for (int r = 0; r < rows; r++)
+    {
+        for (int c = 0; c < cols; c++)
+        {
+            int x = area.x + (int)std::lround(c * step_x);
+            int y = area.y + (int)std::lround(r * step_y);
+            Rect tile = Rect(x, y, tile_w, tile_h) & area;
+            if (tile.area() > 0)
+                tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
 
-    // Данные лежат последовательно, но матрица [84, 8400].
-    // Значит шаг между атрибутами одного анкора = 8400.
-    // data[0][i] = x, data[1][i] = y ...
+// Проверяет, упирается ли бокс во внутреннюю границу тайла (объект обрезан тайлом)
+static bool is_cut_by_tile(const Rect &box, const Rect &tile, const Rect &area, int margin_x, int margin_y)
+{
+    bool left = tile.x > area.x && box.x <= tile.x + margin_x;
+    bool top = tile.y > area.y && box.y <= tile.y + margin_y;
+    bool right = tile.x + tile.width < area.x + area.width &&
+                 box.x + box.width >= tile.x + tile.width - margin_x;
+    bool bottom = tile.y + tile.height < area.y + area.height &&
+                  box.y + box.height >= tile.y + tile.height - margin_y;
+    return left || top || right || bottom;
+}
 
-    for (int i = 0; i < num_anchors; i++)
+// Слияние детекций из разных тайлов.
+// Обычный IoU не ловит пары "целый бокс из соседнего тайла + обрезанный кусок на границе",
+// поэтому для обрезанных боксов дополнительно считаем пересечение к площади меньшего бокса.
+static vector<Detection> merge_tiled_detections(const vector<Detection> &candidates, const vector<bool> &cut,
+                                                float iou_threshold, float ios_threshold)
+{
+    // Сначала целые боксы, внутри группы - по уверенности
+    vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              {
+                  if (cut[a] != cut[b])
+                      return !cut[a];
+                  return candidates[a].confidence > candidates[b].confidence; });
+
+    vector<Detection> kept;
+    vector<bool> kept_cut;
+    for (size_t idx : order)
     {
-        // Ищем класс с максимальной уверенностью
-        float max_score = 0.0;
-        int max_class_id = -1;
+        const Detection &cand = candidates[idx];
+        bool suppressed = false;
 
-        // Пробегаем по классам (начинаются с 4-го ряда)
-        for (int c = 0; c < num_classes; c++)
+        for (size_t k = 0; k < kept.size(); k++)
         {
-            float score = raw_output[(4 + c) * num_anchors + i];
-            if (score > max_score)
+            Detection &other = kept[k];
+            if (other.class_id != cand.class_id)
+                continue;
+
+            int inter = (other.box & cand.box).area();
+            if (inter <= 0)
+                continue;
+
+            float iou = (float)inter / (other.box.area() + cand.box.area() - inter);
+            float ios = (float)inter / std::min(other.box.area(), cand.box.area());
+
+            if (iou > iou_threshold)
+            {
+                suppressed = true;
+            }
+            else if ((cut[idx] || kept_cut[k]) && ios > ios_threshold)
             {
-                max_score = score;
-                max_class_id = c;
+                suppressed = true;
+                // Обрезанный бокс достраиваем кусками из соседних тайлов
+                if (kept_cut[k])
+                {
+                    other.box |= cand.box;
+                    other.confidence = std::max(other.confidence, cand.confidence);
+                }
             }
+
+            if (suppressed)
+                break;
         }
 
-        if (max_score > conf_threshold)
+        if (!suppressed)
         {
-            // Извлекаем координаты
-            float cx = raw_output[0 * num_anchors + i];
-            float cy = raw_output[1 * num_anchors + i];
-            float w = raw_output[2 * num_anchors + i];
-            float h = raw_output[3 * num_anchors + i];
-
-            // Переводим из центра в левый верхний угол и масштабируем
-            int left = int((cx - 0.5 * w) * x_factor);
-            int top = int((cy - 0.5 * h) * y_factor);
-            int width = int(w * x_factor);
-            int height = int(h * y_factor);
-
-            boxes.push_back(Rect(left, top, width, height));
-            confidences.push_back(max_score);
-            class_ids.push_back(max_class_id);
+            kept.push_back(cand);
+            kept_cut.push_back(cut[idx]);
         }
     }
+    return kept;
+}
 
-    // 5. NMS (Убираем дубликаты)
-    vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, conf_threshold, 0.45, nms_result);
+vector<Detection> YOLODetector::detect_tiled(const Mat &image, const YuvLayout *yuv_layout, float conf_threshold)
+{
+    int input_w = input_shape[3];
+    int input_h = input_shape[2];
 
-    for (int idx : nms_result)
+    Size frame_size = yuv_layout ? yuv_image_size(image) : image.size();
+    Rect frame_rect(0, 0, frame_size.width, frame_size.height);
+    Rect area = tiling_config.region.area() > 0 ? (tiling_config.region & frame_rect) : frame_rect;
+    if (area.area() <= 0)
+        area = frame_rect;
+
+    // 1. Раскладка: тайлы + (опционально) весь кадр целиком
+    vector<Rect> views = make_tiles(frame_size);
+    size_t num_tiles = views.size();
+    if (tiling_config.global_view)
+        views.push_back(frame_rect);
+
+    // 2. Один блоб [N, 3, H, W] на все тайлы
+    Mat blob;
+    make_blob(image, yuv_layout, views, blob);
+
+    // 3. Инференс: одним батчем, если модель позволяет, иначе по одному тайлу
+    vector<vector<Ort::Value>> outputs;
+    int64_t batch = (int64_t)views.size();
+    if (dynamic_batch)
     {
-        Detection result;
-        result.class_id = class_ids[idx];
-        result.confidence = confidences[idx];
-        result.box = boxes[idx];
-        detections.push_back(result);
+        outputs.push_back(run((float *)blob.data, batch));
+    }
+    else
+    {
+        size_t image_size = 3 * input_w * input_h;
+        for (int64_t b = 0; b < batch; b++)
+            outputs.push_back(run((float *)blob.data + b * image_size, 1));
     }
 
-    return detections;
-}
\ No newline at end of file
+    // 4. Декодируем каждый тайл в координаты кадра
+    vector<Detection> candidates;
+    vector<bool> cut;
+    for (size_t v = 0; v < views.size(); v++)
+    {
+        Ort::Value &output = dynamic_batch ? outputs[0][0] : outputs[v][0];
+        auto output_dims = output.GetTensorTypeAndShapeInfo().GetShape();
+        size_t item_size = output_dims[1] * output_dims[2];
+        const float *data = output.GetTensorMutableData<float>() + (dynamic_batch ? v * item_size : 0);
+
+        size_t first = candidates.size();
+        decode(data, output_dims, conf_threshold, views[v], candidates);
+
+        // Боксы глобального вида никогда не обрезаны тайлом.
+        // 2 пикселя входа модели в пикселях кадра - по каждой оси свой масштаб
+        int margin_x = (int)std::ceil(2.0f * views[v].width / input_w);
+        int margin_y = (int)std::ceil(2.0f * views[v].height / input_h);
+        for (size_t i = first; i < candidates.size(); i++)
+            cut.push_back(v < num_tiles && is_cut_by_tile(candidates[i].box, views[v], area, margin_x, margin_y));
+    }
+
+    // 5. Слияние между тайлами
+    return merge_tiled_detections(candidates, cut, 0.45f, 0.6f);
+}
@@ -1,11 +1,87 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include "detector.h"
-#include "tracker.h"
+#include "counting_stream.h"
+#include "counter_engine.h"
+#include "control_server.h"
+#include "batch_processor.h"
+#include "clip_recorder.h"
+#include "preview_server.h"
 #include "fps_counter.h"
-#include <set>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
 #include "database.h"
 
+// Движок демона для обработчика сигналов (SIGINT/SIGTERM -> мягкая остановка)
+static CounterEngine *g_engine = nullptr;
+
+static void handle_signal(int)
+{
+    if (g_engine)
+        g_engine->stop();
+}
+
+// Числовые аргументы: строка должна быть числом целиком ("12abc" и пустая строка - ошибка)
+static bool parse_number(const char *text, double &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && errno == 0 && std::isfinite(value);
+}
+
+static bool parse_number(const char *text, float &value)
+{
+    double parsed;
+    if (!parse_number(text, parsed))
+        return false;
+    value = static_cast<float>(parsed);
+    return true;
+}
+
+static bool parse_number(const char *text, int &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || parsed < INT_MIN || parsed > INT_MAX)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Несколько целых через разделитель ("3x2", "0,800,3840,1000"): ровно count чисел, без мусора
+static bool parse_int_list(const char *text, char separator, int *values, size_t count)
+{
+    std::string rest = text;
+    for (size_t k = 0; k < count; k++)
+    {
+        size_t pos = k + 1 < count ? rest.find(separator) : std::string::npos;
+        if (k + 1 < count && pos == std::string::npos)
+            return false;
+        std::string part = rest.substr(0, pos);
+        if (!parse_number(part.c_str(), values[k]))
+            return false;
+        rest = pos == std::string::npos ? "" : rest.substr(pos + 1);
+    }
+    return true;
+}
+
+// FPS в правом верхнем углу кадра (и текущий, и средний)
+static void draw_fps(cv::Mat &view, float instant_fps, float avg_fps)
+{
+    std::string fps_text = "FPS: " + std::to_string(static_cast<int>(instant_fps)) +
+                           " (avg: " + std::to_string(static_cast<int>(avg_fps)) + ")";
+    int baseline = 0;
+    cv::Size text_size = cv::getTextSize(fps_text, cv::FONT_HERSHEY_SIMPLEX, 1, 2, &baseline);
+    cv::Point fps_position(view.cols - text_size.width - 20, 40); // 20px padding from right edge
+    cv::putText(view, fps_text, fps_position,
+                cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 255), 2);
+}
+
 void print_usage(const char *program_name)
 {
     std::cout << "Usage: " << program_name << " [options]\n\n"
@@ -17,12 +93,40 @@ void print_usage(const char *program_name)
               << "  --headless          Run without display window (save to file only)\n"
               << "  --loop              Loop video infinitely (for camera-like streaming)\n"
               << "  --cpu               Use CPU only (default: GPU if available)\n"
+              << "  --yuv               Feed raw NV12/I420 decoder frames to the model (GStreamer), BGR only for display\n"
+              << "  --tiles <CxR>       Tiled inference for high-res frames, 1-16 each, e.g. 3x2 (default: off)\n"
+              << "  --tile-overlap <f>  Overlap between neighbouring tiles, 0.0-0.9 (default: 0.2)\n"
+              << "  --tile-region <x,y,w,h>  Restrict tiles to a region, e.g. the counting zone\n"
+              << "  --no-global-view    Do not add the downscaled full frame to the tile batch\n"
+              << "  --head <format>     Output head: v8 (v8/v11), v5, e2e (v10, NMS-free) (default: auto)\n"
+              << "  --line <y>          Counting line position in pixels (default: middle of the frame)\n"
+              << "  --conf <f>          Detection confidence threshold, 0-1 exclusive (default: 0.5)\n"
+              << "  --classes <list>    Counted classes, each with its own tracker: person,car:140:10 (default: person)\n"
+              << "  --trajectories <dir>  Store per-track trajectories in <dir>/<stream> (default: off)\n"
+              << "  --clips <dir>       Save a short clip around every crossing to <dir>/<stream> (default: off)\n"
+              << "  --clip-pre <s>      Seconds of video before a crossing (default: 5)\n"
+              << "  --clip-post <s>     Seconds of video after a crossing (default: 5)\n"
+              << "  --batch <path>      Offline re-count of a video file or directory on parallel workers\n"
+              << "  --workers <n>       Batch workers, each with its own detector (default: CPU cores with --cpu, 1 on GPU)\n"
+              << "  --chunk-minutes <m> Batch chunk length in minutes (default: 10)\n"
+              << "  --overlap-seconds <s>  Tracker warm-up before each chunk (default: 10)\n"
+              << "  --preview <port>    Serve a live MJPEG preview over HTTP instead of the window (0 = any free port)\n"
+              << "  --preview-bind <ip> Preview listen address (default: 127.0.0.1)\n"
+              << "  --preview-fps <f>   Preview frame rate cap (default: 10)\n"
+              << "  --preview-width <w> Preview frame width cap (default: 960)\n"
+              << "  --daemon            Run as a daemon controlled through a Unix socket\n"
+              << "  --socket <path>     Control socket path (default: /tmp/smart_counter.sock)\n"
               << "  --help              Show this help message\n"
               << "\nExamples:\n"
               << "  " << program_name << " --input video.mp4\n"
               << "  " << program_name << " --model models/yolov8n.onnx --headless --loop\n"
               << "  " << program_name << " --input video.mp4 --output result.mp4 --cpu\n"
+              << "  " << program_name << " --input rtsp://cam/stream --headless --output \"\" --clips data/clips\n"
               << "  " << program_name << " --db data_logs/analytics.db --loop\n"
+              << "  " << program_name << " --input 4k.mp4 --tiles 3x2 --tile-region 0,800,3840,1000\n"
+              << "  " << program_name << " --daemon --socket /run/smart_counter.sock\n"
+              << "  " << program_name << " --headless --preview 8080 --preview-bind 0.0.0.0\n"
+              << "  " << program_name << " --batch /archive/2024-05-01 --cpu --workers 16\n"
               << std::endl;
 }
 
@@ -35,7 +139,22 @@ int main(int argc, char **argv)
     std::string db_path = "logs/analytics.db";
     bool headless_mode = false;
     bool loop_video = false;
+    bool yuv_capture = false;
     bool use_gpu = true;
+    TilingConfig tiling;
+    std::string head_name; // Пусто = определить по модели
+    std::vector<ClassTrackingConfig> counted_classes; // Пусто = только люди
+    int line_y = -1;         // -1 = середина кадра
+    float conf_threshold = 0.5f;
+    bool daemon_mode = false;
+    bool preview_enabled = false;
+    PreviewConfig preview_config;
+    bool input_given = false;
+    std::string socket_path = "/tmp/smart_counter.sock";
+    std::string trajectory_dir; // Пусто = не сохранять траектории
+    ClipConfig clip_config;     // dir пуст = не писать клипы
+    std::string batch_input;    // Пусто = обычный режим
+    BatchConfig batch;
 
     // Parse command-line arguments
     for (int i = 1; i < argc; i++)
@@ -59,6 +178,10 @@ int main(int argc, char **argv)
         {
             use_gpu = false;
         }
+        else if (arg == "--yuv")
+        {
+            yuv_capture = true;
+        }
         else if (arg == "--model" && i + 1 < argc)
         {
             model_path = argv[++i];
@@ -66,6 +189,7 @@ int main(int argc, char **argv)
         else if (arg == "--input" && i + 1 < argc)
         {
             video_path = argv[++i];
+            input_given = true;
         }
         else if (arg == "--output" && i + 1 < argc)
         {
@@ -75,6 +199,166 @@ int main(int argc, char **argv)
         {
             db_path = argv[++i];
         }
+        else if (arg == "--tiles" && i + 1 < argc)
+        {
+            int grid[2];
+            if (!parse_int_list(argv[++i], 'x', grid, 2) || grid[0] < 1 || grid[0] > 16 || grid[1] < 1 || grid[1] > 16)
+            {
+                std::cerr << "Invalid --tiles value (expected CxR with 1-16 each, e.g. 3x2): " << argv[i] << std::endl;
+                return 1;
+            }
+            tiling.cols = grid[0];
+            tiling.rows = grid[1];
+            tiling.enabled = true;
+        }
+        else if (arg == "--tile-overlap" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], tiling.overlap) || !(tiling.overlap >= 0.0f && tiling.overlap <= 0.9f))
+            {
+                std::cerr << "Invalid --tile-overlap value (expected 0.0 - 0.9): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--tile-region" && i + 1 < argc)
+        {
+            int r[4];
+            if (!parse_int_list(argv[++i], ',', r, 4) || r[0] < 0 || r[1] < 0 || r[2] <= 0 || r[3] <= 0)
+            {
+                std::cerr << "Invalid --tile-region value (expected x,y,w,h with x,y >= 0 and w,h > 0): " << argv[i] << std::endl;
+                return 1;
+            }
+            tiling.region = cv::Rect(r[0], r[1], r[2], r[3]);
+        }
+        else if (arg == "--no-global-view")
+        {
+            tiling.global_view = false;
+        }
+        else if (arg == "--line" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], line_y) || !(line_y >= -1))
+            {
+                std::cerr << "Invalid --line value (expected y >= 0, or -1 for the middle): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--conf" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], conf_threshold) || !(conf_threshold > 0.0f && conf_threshold < 1.0f))
+            {
+                std::cerr << "Invalid --conf value (expected a number in (0, 1)): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--trajectories" && i + 1 < argc)
+        {
+            trajectory_dir = argv[++i];
+        }
+        else if (arg == "--clips" && i + 1 < argc)
+        {
+            clip_config.dir = argv[++i];
+        }
+        else if (arg == "--clip-pre" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], clip_config.pre_seconds) || !(clip_config.pre_seconds >= 0.0))
+            {
+                std::cerr << "Invalid --clip-pre value (expected seconds >= 0): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--clip-post" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], clip_config.post_seconds) || !(clip_config.post_seconds >= 0.0))
+            {
+                std::cerr << "Invalid --clip-post value (expected seconds >= 0): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_input = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], batch.workers) || !(batch.workers >= 0))
+            {
+                std::cerr << "Invalid --workers value (expected count >= 0, 0 = auto): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--chunk-minutes" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], batch.chunk_seconds) || !(batch.chunk_seconds > 0.0))
+            {
+                std::cerr << "Invalid --chunk-minutes value (expected minutes > 0): " << argv[i] << std::endl;
+                return 1;
+            }
+            batch.chunk_seconds *= 60.0;
+        }
+        else if (arg == "--overlap-seconds" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], batch.overlap_seconds) || !(batch.overlap_seconds >= 0.0))
+            {
+                std::cerr << "Invalid --overlap-seconds value (expected seconds >= 0): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--daemon")
+        {
+            daemon_mode = true;
+        }
+        else if (arg == "--socket" && i + 1 < argc)
+        {
+            socket_path = argv[++i];
+        }
+        else if (arg == "--preview" && i + 1 < argc)
+        {
+            preview_enabled = true;
+            if (!parse_number(argv[++i], preview_config.port) || !(preview_config.port >= 0 && preview_config.port <= 65535))
+            {
+                std::cerr << "Invalid --preview value (expected port 0 - 65535): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--preview-bind" && i + 1 < argc)
+        {
+            preview_config.bind_address = argv[++i];
+        }
+        else if (arg == "--preview-fps" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], preview_config.max_fps) || !(preview_config.max_fps > 0.0))
+            {
+                std::cerr << "Invalid --preview-fps value (expected fps > 0): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--preview-width" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], preview_config.max_width) || !(preview_config.max_width >= 16))
+            {
+                std::cerr << "Invalid --preview-width value (expected width >= 16): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--classes" && i + 1 < argc)
+        {
+            std::string spec = argv[++i];
+            std::string error;
+            if (!parse_counted_classes(spec, counted_classes, error))
+            {
+                std::cerr << "Invalid --classes '" << spec << "': " << error << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--head" && i + 1 < argc)
+        {
+            head_name = argv[++i];
+            HeadFormat format;
+            if (!parse_head_format(head_name, format))
+            {
+                std::cerr << "Unknown --head format: " << head_name << " (expected v8, v5 or e2e)" << std::endl;
+                return 1;
+            }
+        }
         else if (arg.substr(0, 2) == "--")
         {
             std::cerr << "Unknown option: " << arg << std::endl;
@@ -83,6 +367,13 @@ int main(int argc, char **argv)
         }
     }
 
+    // Куски архива обрабатываются параллельно и не по порядку - клип вокруг события собрать не из чего
+    if (!batch_input.empty() && !clip_config.dir.empty())
+    {
+        std::cerr << "Error: --clips is not supported with --batch (count_events.video_ms points into the source file)" << std::endl;
+        return 1;
+    }
+
     // Initialize database with configured path
     Database db(db_path);
     db.init();
@@ -99,45 +390,118 @@ int main(int argc, char **argv)
     std::cout << "🔁 Loop mode: " << (loop_video ? "enabled" : "disabled") << std::endl;
     std::cout << "⚡ Using: " << (use_gpu ? "GPU" : "CPU") << std::endl;
 
+    // Офлайн-режим: у каждого рабочего свой детектор, общий здесь не нужен
+    if (!batch_input.empty())
+    {
+        batch.model_path = model_path;
+        batch.use_gpu = use_gpu;
+        batch.head_name = head_name;
+        batch.tiling = tiling;
+        batch.stream.line_y = line_y;
+        batch.stream.conf_threshold = conf_threshold;
+        batch.stream.yuv = yuv_capture;
+        batch.stream.classes = counted_classes;
+
+        BatchProcessor processor(batch);
+        return processor.run(batch_input, db);
+    }
+
     // Инициализация детектора
     std::cout << "\n🔄 Initializing Detector..." << std::endl;
     YOLODetector detector(model_path, use_gpu);
-    SimpleTracker tracker; // Создаем трекер
+    HeadFormat head_format;
+    if (!head_name.empty() && parse_head_format(head_name, head_format))
+    {
+        detector.set_head_format(head_format);
+    }
+    if (tiling.enabled)
+    {
+        detector.set_tiling(tiling);
+        std::cout << "🧩 Tiling: " << tiling.cols << "x" << tiling.rows
+                  << ", overlap " << tiling.overlap
+                  << (tiling.global_view ? " + global view" : "") << std::endl;
+    }
+
+    StreamConfig stream_config;
+    stream_config.source = video_path;
+    stream_config.line_y = line_y;
+    stream_config.conf_threshold = conf_threshold;
+    stream_config.loop = loop_video;
+    stream_config.yuv = yuv_capture;
+    stream_config.classes = counted_classes;
+
+    // Живое превью по HTTP: кадры сжимаются, только пока кто-то смотрит
+    std::unique_ptr<PreviewServer> preview;
+    if (preview_enabled)
+    {
+        preview = std::make_unique<PreviewServer>(preview_config);
+        if (!preview->start())
+            return 1;
+    }
+
+    // Режим демона: модель загружена один раз, потоки и настройки меняются через сокет
+    if (daemon_mode)
+    {
+        CounterEngine engine(detector, db);
+        engine.set_trajectory_dir(trajectory_dir);
+        engine.set_counted_classes(counted_classes);
+        engine.set_preview(preview.get());
+        if (!clip_config.dir.empty())
+            engine.set_clips(clip_config);
+        if (input_given)
+        {
+            std::string error;
+            if (!engine.add_stream(stream_config, error))
+            {
+                std::cerr << "Error: " << error << std::endl;
+                return -1;
+            }
+        }
+
+        ControlServer server(socket_path, [&engine](const std::string &command)
+                             { return engine.submit(command); });
+        if (!server.start())
+            return -1;
+
+        g_engine = &engine;
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        engine.run();
+
+        g_engine = nullptr;
+        server.stop();
+        return 0;
+    }
 
     // Открытие видео
-    cv::VideoCapture cap(video_path);
-    if (!cap.isOpened())
+    CountingStream stream(stream_config);
+    if (!stream.open())
     {
         std::cerr << "Error: Could not open video!" << std::endl;
         return -1;
     }
+    if (!trajectory_dir.empty())
+        stream.enable_trajectories(trajectory_dir + "/" + stream_config.id);
+    if (preview)
+        preview->add_stream(stream_config.id);
+
+    // Окно OpenCV только без превью: превью не требует дисплея и не тормозит цикл до FPS источника
+    bool show_window = !headless_mode && !preview;
 
     // Узнаем FPS видео, чтобы проигрывать с правильной скоростью
-    double video_fps = cap.get(cv::CAP_PROP_FPS);
+    double video_fps = stream.source_fps();
     int delay_ms = 1000 / video_fps; // Например, 1000/25 = 40 мс
 
-    std::set<int> counted_ids;
-    int line_y = cap.get(cv::CAP_PROP_FRAME_HEIGHT) / 2; // Линия на середине кадра
-
-    // Счетчики входа и выхода
-    int count_in = 0;
-    int count_out = 0;
-
     // FPS counter for tracking performance
-    FPSCounter fps_counter;
+    FPSCounter &fps_counter = stream.fps();
 
     // Настройка VideoWriter для headless режима
     cv::VideoWriter video_writer;
-    if (headless_mode)
+    if (headless_mode && !output_path.empty()) // --output "" = только подсчет, без записи видео
     {
-        int frame_width = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
-        int frame_height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
-        double fps = cap.get(cv::CAP_PROP_FPS);
-        if (fps <= 0)
-            fps = 25.0; // Fallback FPS
-
         int fourcc = cv::VideoWriter::fourcc('m', 'p', '4', 'v');
-        video_writer.open(output_path, fourcc, fps, cv::Size(frame_width, frame_height));
+        video_writer.open(output_path, fourcc, video_fps, stream.frame_size());
 
         if (!video_writer.isOpened())
         {
@@ -150,115 +514,66 @@ int main(int argc, char **argv)
         }
     }
 
-    int last_saved_count = 0; // Чтобы не спамить в БД
+    // Клипы по событиям: кольцевой буфер сжатых кадров + фоновая запись
+    std::unique_ptr<ClipRecorder> clips;
+    if (!clip_config.dir.empty())
+    {
+        clips = std::make_unique<ClipRecorder>(clip_config, stream_config.id, video_fps);
+        std::cout << "🎬 Clips: " << clip_config.dir << "/" << stream_config.id
+                  << " (" << clip_config.pre_seconds << "s before, " << clip_config.post_seconds << "s after)" << std::endl;
+    }
+
+    // Аннотированный кадр нужен только окну или файлу (и превью, когда его смотрят);
+    // иначе не тратим время на BGR и отрисовку. Клипы рисуют кадр сами, в своем потоке
+    bool always_view = show_window || video_writer.isOpened();
 
     cv::Mat frame;
     while (true)
     {
-        cap >> frame;
-        // If video ended - restart from beginning (if loop enabled) or exit
-        if (frame.empty())
+        if (!stream.read(frame))
         {
-            if (loop_video)
-            {
-                std::cout << "🔁 Video ended, restarting from beginning..." << std::endl;
-                cap.set(cv::CAP_PROP_POS_FRAMES, 0);
-                cap >> frame;
-                if (frame.empty())
-                {
-                    std::cerr << "❌ Error: Cannot restart video" << std::endl;
-                    break;
-                }
-            }
-            else
-            {
+            if (!loop_video)
                 std::cout << "✅ Video processing completed" << std::endl;
-                break;
-            }
+            break;
         }
 
         // Запуск детекции
         // Засекаем время для честного FPS
         auto start = std::chrono::high_resolution_clock::now();
 
-        // 1. Детекция
-        auto detections = detector.detect(frame, 0.5);
-
-        // 2. Трекинг (превращаем просто боксы в объекты с ID)
-        auto tracked_objects = tracker.update(detections);
-
-        // 3. Логика двунаправленного подсчета
-        cv::Scalar line_color(0, 255, 255); // По умолчанию желтая
-
-        for (const auto &obj : tracked_objects)
-        {
-            // Рисуем бокс и ID
-            cv::rectangle(frame, obj.box, cv::Scalar(0, 255, 0), 2);
-            cv::putText(frame, "ID: " + std::to_string(obj.id),
-                        cv::Point(obj.box.x, obj.box.y - 10),
-                        cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
-
-            // Рисуем центральную точку
-            cv::circle(frame, obj.center, 5, cv::Scalar(0, 255, 0), -1);
+        // 1-3. Детекция, трекинг и подсчет пересечений
+        stream.process(frame, detector);
 
-            // Логика векторного пересечения
-            // Условие 1: Сейчас ниже линии, был выше (ВХОД / DOWN)
-            if (obj.previous_center.y < line_y && obj.center.y >= line_y)
-            {
-                if (counted_ids.find(obj.id) == counted_ids.end())
-                {
-                    count_in++;
-                    counted_ids.insert(obj.id);
-                    line_color = cv::Scalar(0, 255, 0); // Зеленый миг
-                }
-            }
-
-            // Условие 2: Сейчас выше линии, был ниже (ВЫХОД / UP)
-            if (obj.previous_center.y > line_y && obj.center.y <= line_y)
-            {
-                if (counted_ids.find(obj.id) == counted_ids.end())
-                {
-                    count_out++;
-                    counted_ids.insert(obj.id);
-                    line_color = cv::Scalar(0, 0, 255); // Красный миг
-                }
-            }
-        }
+        int count_in = stream.count_in();
+        int count_out = stream.count_out();
 
         // ЛОГИКА СОХРАНЕНИЯ
-        int current_count = count_in + count_out;
-
         // Пишем в базу, только если счетчик увеличился
-        if (current_count > last_saved_count)
+        for (const auto &event : stream.last_events())
+        {
+            std::string clip_path = clips ? clips->trigger() : std::string();
+            db.insert_event(stream_config.id, event.class_id, event.track_id, event.is_in,
+                            event.frame * 1000.0 / video_fps, clip_path);
+        }
+        if (stream.take_count_update())
         {
             db.insert_log(count_in, count_out);
-            last_saved_count = current_count;
+            for (const auto &pair : stream.class_counts())
+                db.insert_class_log(stream_config.id, pair.first, pair.second.name, pair.second.in, pair.second.out);
             std::cout << "📦 Data saved to DB: IN=" << count_in << " OUT=" << count_out << std::endl;
         }
 
-        // Рисуем линию подсчета (цвет меняется при пересечении)
-        cv::line(frame, cv::Point(0, line_y), cv::Point(frame.cols, line_y), line_color, 2);
-
-        // Вычисляем занятость (сколько внутри)
-        int occupancy = count_in - count_out;
-        int corrected_occupancy = std::max(0, occupancy); // Защита от отрицательных значений
+        bool preview_frame = preview && preview->wants_frame(stream_config.id);
+        bool need_view = always_view || preview_frame;
 
-        // Рисуем информационную панель
-        cv::rectangle(frame, cv::Point(0, 0), cv::Point(300, 140), cv::Scalar(0, 0, 0), -1);
-        cv::putText(frame, "IN: " + std::to_string(count_in),
-                    cv::Point(10, 40), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
-        cv::putText(frame, "OUT: " + std::to_string(count_out),
-                    cv::Point(10, 80), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 255), 2);
-
-        // Показываем корректированное значение с предупреждением о дрейфе
-        cv::Scalar occupancy_color = (occupancy < 0) ? cv::Scalar(0, 165, 255) : cv::Scalar(255, 255, 255);
-        std::string occupancy_text = "INSIDE: " + std::to_string(corrected_occupancy);
-        if (occupancy < 0)
+        // Боксы, линия подсчета и информационная панель - только если кадр кто-то увидит.
+        // В YUV-режиме здесь же (и только здесь) происходит конвертация в BGR
+        cv::Mat view;
+        if (need_view)
         {
-            occupancy_text += " (!" + std::to_string(occupancy) + ")";
+            view = stream.to_bgr(frame);
+            stream.annotate(view);
         }
-        cv::putText(frame, occupancy_text,
-                    cv::Point(10, 120), cv::FONT_HERSHEY_SIMPLEX, 0.8, occupancy_color, 2);
 
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -273,13 +588,28 @@ int main(int argc, char **argv)
         int frame_count = fps_counter.getFrameCount();
 
         // Display FPS on frame (showing both average and instantaneous) - top-right corner
-        std::string fps_text = "FPS: " + std::to_string(static_cast<int>(instant_fps)) +
-                               " (avg: " + std::to_string(static_cast<int>(avg_fps)) + ")";
-        int baseline = 0;
-        cv::Size text_size = cv::getTextSize(fps_text, cv::FONT_HERSHEY_SIMPLEX, 1, 2, &baseline);
-        cv::Point fps_position(frame.cols - text_size.width - 20, 40); // 20px padding from right edge
-        cv::putText(frame, fps_text, fps_position,
-                    cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 255), 2);
+        if (need_view)
+            draw_fps(view, instant_fps, avg_fps);
+
+        // Кадр в кольцевой буфер клипов: готовый view копируется как есть, иначе копируется
+        // исходный кадр, а BGR и разметка по снимку рисуются в потоке сжатия клипов
+        if (clips && need_view)
+        {
+            clips->push(view);
+        }
+        else if (clips)
+        {
+            clips->push(frame, [overlay = stream.overlay(), instant_fps, avg_fps](const cv::Mat &raw)
+                        {
+                            cv::Mat clip_view = CountingStream::render(raw, overlay);
+                            draw_fps(clip_view, instant_fps, avg_fps);
+                            return clip_view;
+                        });
+        }
+
+        // Превью только забирает копию кадра; сжатие - в потоке сервера
+        if (preview_frame)
+            preview->publish(stream_config.id, view);
 
         // Print periodic statistics every 60 frames
         if (frame_count > 0 && frame_count % 60 == 0)
@@ -291,12 +621,12 @@ int main(int argc, char **argv)
         }
 
         // Отображение или запись в зависимости от режима
-        if (headless_mode)
+        if (!show_window)
         {
-            // В headless режиме просто пишем в файл
+            // Без окна (headless или превью) только пишем в файл, если он задан
             if (video_writer.isOpened())
             {
-                video_writer.write(frame);
+                video_writer.write(view);
             }
             // Small delay to control processing speed and allow database writes
             cv::waitKey(1);
@@ -304,7 +634,7 @@ int main(int argc, char **argv)
         else
         {
             // В обычном режиме показываем окно
-            cv::imshow("C++ YOLOv8 Inference", frame);
+            cv::imshow("C++ YOLOv8 Inference", view);
             if (cv::waitKey(delay_ms) == 'q')
                 break;
         }
@@ -317,6 +647,13 @@ int main(int argc, char **argv)
         std::cout << "✅ Output saved to: " << output_path << std::endl;
     }
 
+    // Дописываем открытый клип и ждем фоновую запись
+    if (clips)
+    {
+        clips->finish();
+        std::cout << "✅ Clips saved: " << clips->clips_written() << std::endl;
+    }
+
     // Print final summary
     std::cout << "\n--- Summary ---" << std::endl;
     std::cout << "Frames processed: " << fps_counter.getFrameCount() << std::endl;
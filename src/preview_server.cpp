@@ -0,0 +1,426 @@
+#include "preview_server.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char *kBoundary = "smartcounterframe";
+
+// Пишет все байты; MSG_NOSIGNAL - отключившийся клиент не должен ронять процесс через SIGPIPE
+static bool send_all(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool send_all(int fd, const string &text)
+{
+    return send_all(fd, text.data(), text.size());
+}
+
+static void send_status(int fd, const string &status, const string &body)
+{
+    send_all(fd, "HTTP/1.0 " + status + "\r\nContent-Type: text/plain\r\nContent-Length: " +
+                     to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+}
+
+// ID потока задается командой add и может содержать что угодно - в HTML только экранированным
+static string html_escape(const string &text)
+{
+    string out;
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        case '\'': out += "&#39;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+static string url_encode(const string &text)
+{
+    static const char *hex = "0123456789ABCDEF";
+    string out;
+    for (unsigned char c : text)
+    {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            out += static_cast<char>(c);
+        }
+        else
+        {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+// false - битая %-последовательность
+static bool url_decode(const string &text, string &out)
+{
+    out.clear();
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] != '%')
+        {
+            out += text[i];
+            continue;
+        }
+        if (i + 2 >= text.size() || !isxdigit((unsigned char)text[i + 1]) || !isxdigit((unsigned char)text[i + 2]))
+            return false;
+        out += static_cast<char>(stoi(text.substr(i + 1, 2), nullptr, 16));
+        i += 2;
+    }
+    return true;
+}
+
+PreviewServer::PreviewServer(const PreviewConfig &config) : config(config) {}
+
+PreviewServer::~PreviewServer()
+{
+    stop();
+}
+
+bool PreviewServer::start()
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config.port));
+    if (inet_pton(AF_INET, config.bind_address.c_str(), &addr.sin_addr) != 1)
+    {
+        cerr << "❌ Invalid preview bind address: " << config.bind_address << endl;
+        return false;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        cerr << "❌ Can't create preview socket: " << strerror(errno) << endl;
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 8) < 0)
+    {
+        cerr << "❌ Can't listen on " << config.bind_address << ":" << config.port << ": " << strerror(errno) << endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    bound_port = ntohs(addr.sin_port);
+
+    running = true;
+    accept_thread = thread(&PreviewServer::accept_loop, this);
+    encoder_thread = thread(&PreviewServer::encoder_loop, this);
+    cout << "📺 Preview: http://" << config.bind_address << ":" << bound_port << "/" << endl;
+    return true;
+}
+
+void PreviewServer::stop()
+{
+    if (!running.exchange(false))
+        return;
+
+    pending_cv.notify_all();
+    frames_cv.notify_all();
+    if (accept_thread.joinable())
+        accept_thread.join();
+    if (encoder_thread.joinable())
+        encoder_thread.join();
+
+    {
+        unique_lock<std::mutex> lock(mutex);
+        clients_done.wait(lock, [this]
+                          { return active_clients == 0; });
+    }
+
+    close(listen_fd);
+    listen_fd = -1;
+}
+
+void PreviewServer::add_stream(const string &id)
+{
+    lock_guard<std::mutex> lock(mutex);
+    if (!slots.count(id))
+        slots[id] = make_shared<Slot>();
+}
+
+void PreviewServer::remove_stream(const string &id)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(id);
+    if (it == slots.end())
+        return;
+    it->second->removed = true; // Клиенты этого потока отключатся сами
+    slots.erase(it);
+    frames_cv.notify_all();
+}
+
+bool PreviewServer::wants_frame(const string &id)
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(id);
+    if (it == slots.end() || it->second->clients == 0)
+        return false;
+
+    auto interval = chrono::duration<double>(1.0 / max(0.1, config.max_fps));
+    return chrono::steady_clock::now() - it->second->last_publish >= interval;
+}
+
+void PreviewServer::publish(const string &id, const cv::Mat &frame)
+{
+    // Уменьшение - на вызывающем потоке, зато в слот попадает собственная маленькая копия
+    cv::Mat small;
+    if (frame.cols > config.max_width)
+    {
+        double scale = (double)config.max_width / frame.cols;
+        cv::resize(frame, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+    else
+    {
+        frame.copyTo(small);
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(id);
+    if (it == slots.end())
+        return;
+    it->second->pending = small; // Несжатый предыдущий кадр просто заменяется
+    it->second->last_publish = chrono::steady_clock::now();
+    pending_cv.notify_one();
+}
+
+void PreviewServer::encoder_loop()
+{
+    const vector<int> params = {cv::IMWRITE_JPEG_QUALITY, config.jpeg_quality};
+
+    while (running)
+    {
+        shared_ptr<Slot> slot;
+        cv::Mat image;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            pending_cv.wait_for(lock, chrono::milliseconds(200));
+            for (auto &pair : slots)
+            {
+                if (!pair.second->pending.empty())
+                {
+                    slot = pair.second;
+                    image = slot->pending;
+                    slot->pending.release();
+                    break;
+                }
+            }
+        }
+        if (!slot)
+            continue;
+
+        auto jpeg = make_shared<vector<uint8_t>>();
+        cv::imencode(".jpg", image, *jpeg, params);
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            slot->jpeg = std::move(jpeg);
+            slot->seq++;
+        }
+        frames_cv.notify_all();
+        pending_cv.notify_one(); // Могли остаться кадры других потоков
+    }
+}
+
+void PreviewServer::accept_loop()
+{
+    while (running)
+    {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+
+        // Зависший клиент не должен держать поток вечно
+        timeval timeout{5, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Один поток на клиента - поэтому число клиентов ограничено
+        bool accepted;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            accepted = active_clients < config.max_clients;
+            if (accepted)
+                active_clients++;
+        }
+        if (!accepted)
+        {
+            send_status(client_fd, "503 Service Unavailable", "Too many preview clients\n");
+            close(client_fd);
+            continue;
+        }
+        thread(&PreviewServer::serve_client, this, client_fd).detach();
+    }
+}
+
+void PreviewServer::serve_client(int client_fd)
+{
+    // Читаем заголовок запроса (нужна только первая строка)
+    string request;
+    char chunk[1024];
+    while (running && request.find("\r\n\r\n") == string::npos && request.size() < 8192)
+    {
+        pollfd pfd{client_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 2000) <= 0)
+            break;
+        ssize_t n = recv(client_fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            break;
+        request.append(chunk, n);
+    }
+
+    istringstream line(request.substr(0, request.find("\r\n")));
+    string method, raw_path, path;
+    line >> method >> raw_path;
+
+    if (!url_decode(raw_path, path))
+        send_status(client_fd, "400 Bad Request", "Bad request path\n");
+    else if (method != "GET")
+        send_status(client_fd, "405 Method Not Allowed", "Only GET is supported\n");
+    else if (path == "/")
+        serve_index(client_fd);
+    else if (path.rfind("/stream/", 0) == 0)
+        serve_stream(client_fd, path.substr(8), false);
+    else if (path.rfind("/snapshot/", 0) == 0)
+        serve_stream(client_fd, path.substr(10), true);
+    else
+        send_status(client_fd, "404 Not Found", "Not found\n");
+
+    close(client_fd);
+
+    lock_guard<std::mutex> lock(mutex);
+    active_clients--;
+    clients_done.notify_all();
+}
+
+void PreviewServer::serve_index(int client_fd)
+{
+    ostringstream body;
+    body << "<html><head><title>Smart Counter</title></head><body>\n";
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for (const auto &pair : slots)
+        {
+            body << "<h3>" << html_escape(pair.first) << "</h3><img src=\"/stream/" << url_encode(pair.first) << "\">\n";
+        }
+    }
+    body << "</body></html>\n";
+
+    string html = body.str();
+    send_all(client_fd, "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\nContent-Length: " +
+                            to_string(html.size()) + "\r\nConnection: close\r\n\r\n" + html);
+}
+
+void PreviewServer::serve_stream(int client_fd, const string &id, bool single)
+{
+    shared_ptr<Slot> slot;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto it = slots.find(id);
+        if (it != slots.end())
+        {
+            slot = it->second;
+            slot->clients++; // С этого момента конвейер начинает отдавать кадры
+        }
+    }
+    if (!slot)
+    {
+        send_status(client_fd, "404 Not Found", "Unknown stream\n");
+        return;
+    }
+
+    if (!single)
+    {
+        send_all(client_fd, string("HTTP/1.0 200 OK\r\nCache-Control: no-cache\r\nConnection: close\r\n"
+                                   "Content-Type: multipart/x-mixed-replace; boundary=") +
+                                kBoundary + "\r\n\r\n");
+    }
+
+    // Старый кадр, сжатый до подключения, не отдаем - ждем свежий
+    uint64_t seen;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        seen = slot->seq;
+    }
+    // Снимок приостановленного потока не ждем вечно
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+
+    while (running)
+    {
+        if (single && chrono::steady_clock::now() > deadline)
+        {
+            send_status(client_fd, "503 Service Unavailable", "No frames from stream\n");
+            break;
+        }
+
+        Jpeg jpeg;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            frames_cv.wait_for(lock, chrono::milliseconds(200), [&]
+                               { return !running || slot->removed || slot->seq != seen; });
+            if (!running || slot->removed)
+                break;
+            if (slot->seq == seen)
+                continue;
+            jpeg = slot->jpeg;
+            seen = slot->seq;
+        }
+
+        bool ok;
+        if (single)
+        {
+            ok = send_all(client_fd, "HTTP/1.0 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                                         to_string(jpeg->size()) + "\r\nConnection: close\r\n\r\n") &&
+                 send_all(client_fd, jpeg->data(), jpeg->size());
+        }
+        else
+        {
+            ok = send_all(client_fd, string("--") + kBoundary + "\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                                         to_string(jpeg->size()) + "\r\n\r\n") &&
+                 send_all(client_fd, jpeg->data(), jpeg->size()) &&
+                 send_all(client_fd, "\r\n");
+        }
+        if (!ok || single)
+            break; // Клиент отключился (или снимок отдан)
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    slot->clients--;
+}
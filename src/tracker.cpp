@@ -1,12 +1,18 @@
 #include "tracker.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
+#include <future>
 #include <limits>
 
 using namespace std;
 using namespace cv;
 
-SimpleTracker::SimpleTracker(int max_frames_missing, int distance_threshold)
-    : max_frames_missing(max_frames_missing), distance_threshold(distance_threshold) {}
+SimpleTracker::SimpleTracker(int max_frames_missing, int distance_threshold, int class_id)
+    : max_frames_missing(max_frames_missing), distance_threshold(distance_threshold), class_id(class_id) {}
 
 float SimpleTracker::calculate_distance(Point p1, Point p2)
 {
@@ -15,13 +21,15 @@ float SimpleTracker::calculate_distance(Point p1, Point p2)
 
 vector<TrackedObject> SimpleTracker::update(const vector<Detection> &detections)
 {
+    removed.clear();
+
     // 1. Превращаем детекции в центроиды
     vector<Point> input_centroids;
     vector<Rect> input_boxes;
     for (const auto &det : detections)
     {
-        if (det.class_id != 0)
-            continue; // Тречим только людей
+        if (det.class_id != class_id)
+            continue; // Тречим только свой класс
 
         Point center(det.box.x + det.box.width / 2, det.box.y + det.box.height / 2);
         input_centroids.push_back(center);
@@ -35,6 +43,7 @@ vector<TrackedObject> SimpleTracker::update(const vector<Detection> &detections)
         {
             TrackedObject obj;
             obj.id = next_id++;
+            obj.class_id = class_id;
             obj.center = input_centroids[i];
             obj.previous_center = input_centroids[i]; // Для новых объектов предыдущая позиция = текущая
             obj.box = input_boxes[i];
@@ -91,6 +100,7 @@ vector<TrackedObject> SimpleTracker::update(const vector<Detection> &detections)
             // Никого рядом нет -> Новый объект
             TrackedObject new_obj;
             new_obj.id = next_id++;
+            new_obj.class_id = class_id;
             new_obj.center = current_center;
             new_obj.previous_center = current_center; // Для новых объектов предыдущая позиция = текущая
             new_obj.box = input_boxes[i];
@@ -106,6 +116,7 @@ vector<TrackedObject> SimpleTracker::update(const vector<Detection> &detections)
     {
         if (it->second.frames_since_seen > max_frames_missing)
         {
+            removed.push_back(it->first);
             it = objects.erase(it);
         }
         else
@@ -125,4 +136,221 @@ vector<TrackedObject> SimpleTracker::update(const vector<Detection> &detections)
         }
     }
     return result;
-}
\ No newline at end of file
+}
+
+// --- Несколько классов ---
+
+static const char *kCocoNames[] = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+    "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+    "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+    "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+    "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+    "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+    "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+    "hair drier", "toothbrush"};
+static const int kCocoClasses = sizeof(kCocoNames) / sizeof(kCocoNames[0]);
+
+// Суммарная работа сопоставления (треки x детекции), начиная с которой партиции считаются параллельно.
+// Ниже этого запуск потоков дороже самого сопоставления
+static const size_t kParallelWork = 4096;
+
+string coco_class_name(int class_id)
+{
+    if (class_id >= 0 && class_id < kCocoClasses)
+        return kCocoNames[class_id];
+    return "class_" + to_string(class_id);
+}
+
+static ClassTrackingConfig default_class_config(int class_id)
+{
+    ClassTrackingConfig config;
+    config.class_id = class_id;
+    config.name = coco_class_name(class_id);
+    switch (class_id)
+    {
+    case 1: // bicycle
+    case 3: // motorcycle
+        config.distance_threshold = 90;
+        config.max_frames_missing = 8;
+        break;
+    case 2: // car
+    case 5: // bus
+    case 7: // truck
+        config.distance_threshold = 140;
+        config.max_frames_missing = 10;
+        break;
+    default:
+        break;
+    }
+    return config;
+}
+
+// Целое число целиком ("10x" и пустая строка - ошибка), как parse_number() в main.cpp
+static bool parse_int(const string &text, int &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || end != text.c_str() + text.size() || errno != 0 || parsed < INT_MIN || parsed > INT_MAX)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parse_counted_classes(const string &spec, vector<ClassTrackingConfig> &classes, string &error)
+{
+    classes.clear();
+    size_t start = 0;
+    while (start <= spec.size())
+    {
+        size_t comma = spec.find(',', start);
+        string item = spec.substr(start, comma == string::npos ? string::npos : comma - start);
+        start = comma == string::npos ? spec.size() + 1 : comma + 1;
+        if (item.empty())
+            continue;
+
+        // name[:distance[:max_missing]]
+        vector<string> parts;
+        size_t p = 0;
+        while (true)
+        {
+            size_t colon = item.find(':', p);
+            parts.push_back(item.substr(p, colon == string::npos ? string::npos : colon - p));
+            if (colon == string::npos)
+                break;
+            p = colon + 1;
+        }
+        if (parts.size() > 3)
+        {
+            error = "too many ':' in '" + item + "' (expected name[:distance[:max_missing]])";
+            return false;
+        }
+
+        int class_id = -1;
+        if (!parts[0].empty() && all_of(parts[0].begin(), parts[0].end(), ::isdigit))
+        {
+            // Только цифры - значит, id не отрицательный; проверяем переполнение
+            if (!parse_int(parts[0], class_id))
+            {
+                error = "class id out of range in '" + item + "'";
+                return false;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < kCocoClasses; i++)
+            {
+                if (parts[0] == kCocoNames[i])
+                    class_id = i;
+            }
+        }
+        if (class_id < 0)
+        {
+            error = "unknown class '" + parts[0] + "'";
+            return false;
+        }
+
+        // Отрицательное расстояние не сопоставит ни одну детекцию, а max_missing < 0 сбросит все треки
+        ClassTrackingConfig config = default_class_config(class_id);
+        if (parts.size() > 1 && !parts[1].empty() &&
+            (!parse_int(parts[1], config.distance_threshold) || config.distance_threshold <= 0))
+        {
+            error = "bad distance in '" + item + "' (expected an integer > 0)";
+            return false;
+        }
+        if (parts.size() > 2 && !parts[2].empty() &&
+            (!parse_int(parts[2], config.max_frames_missing) || config.max_frames_missing < 0))
+        {
+            error = "bad max_missing in '" + item + "' (expected an integer >= 0)";
+            return false;
+        }
+
+        for (const auto &existing : classes)
+        {
+            if (existing.class_id == class_id)
+            {
+                error = "class '" + config.name + "' listed twice";
+                return false;
+            }
+        }
+        classes.push_back(config);
+    }
+
+    if (classes.empty())
+    {
+        error = "no classes given";
+        return false;
+    }
+    return true;
+}
+
+MultiClassTracker::MultiClassTracker(const vector<ClassTrackingConfig> &classes)
+    : configs(classes)
+{
+    if (configs.empty())
+        configs.push_back(default_class_config(0));
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const auto &c = configs[i];
+        partitions.emplace_back(c.max_frames_missing, c.distance_threshold, c.class_id);
+        partition_index[c.class_id] = i;
+    }
+}
+
+vector<TrackedObject> MultiClassTracker::update(const vector<Detection> &detections)
+{
+    // 1. Раскладываем детекции по партициям за один проход; неподсчитываемые классы отбрасываем
+    vector<vector<Detection>> buckets(partitions.size());
+    for (const auto &det : detections)
+    {
+        auto it = partition_index.find(det.class_id);
+        if (it != partition_index.end())
+            buckets[it->second].push_back(det);
+    }
+
+    // 2. Обновляем партиции; крупные - параллельно (партиции не делят состояние)
+    size_t work = 0;
+    int busy = 0;
+    for (size_t i = 0; i < partitions.size(); i++)
+    {
+        size_t tracks = max<size_t>(1, partitions[i].size());
+        work += tracks * buckets[i].size();
+        if (!buckets[i].empty() || partitions[i].size() > 0)
+            busy++;
+    }
+
+    vector<vector<TrackedObject>> results(partitions.size());
+    if (busy > 1 && work >= kParallelWork)
+    {
+        vector<future<void>> jobs;
+        for (size_t i = 1; i < partitions.size(); i++)
+        {
+            if (buckets[i].empty() && partitions[i].size() == 0)
+                continue; // Пустая партиция: обновлять нечего
+            jobs.push_back(async(launch::async, [this, &buckets, &results, i]()
+                                 { results[i] = partitions[i].update(buckets[i]); }));
+        }
+        results[0] = partitions[0].update(buckets[0]);
+        for (auto &job : jobs)
+            job.get();
+    }
+    else
+    {
+        for (size_t i = 0; i < partitions.size(); i++)
+            results[i] = partitions[i].update(buckets[i]);
+    }
+
+    // 3. Собираем результат и закончившиеся треки
+    removed.clear();
+    vector<TrackedObject> merged;
+    for (size_t i = 0; i < partitions.size(); i++)
+    {
+        merged.insert(merged.end(), results[i].begin(), results[i].end());
+        for (int id : partitions[i].removed_ids())
+            removed.emplace_back(configs[i].class_id, id);
+    }
+    return merged;
+}
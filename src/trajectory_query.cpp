@@ -0,0 +1,127 @@
+// Утилита для выборки траекторий, сохраненных SmartCounter --trajectories
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include "trajectory_store.h"
+
+// Время целиком ("12abc" и пустая строка - ошибка)
+static bool parse_ms(const char *text, int64_t &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long long parsed = std::strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || parsed < 0)
+        return false;
+    value = parsed;
+    return true;
+}
+
+void print_usage(const char *program_name)
+{
+    std::cout << "Usage: " << program_name << " --dir <path> [options]\n\n"
+              << "Options:\n"
+              << "  --dir <path>          Trajectory directory of one stream (e.g. logs/trajectories/default)\n"
+              << "  --from <unix_ms>      Only tracks alive after this time\n"
+              << "  --to <unix_ms>        Only tracks alive before this time\n"
+              << "  --region <x,y,w,h>    Only tracks with at least one point inside the region\n"
+              << "  --points              Print every point as CSV (default: one summary line per track)\n"
+              << "  --help                Show this help message\n"
+              << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir;
+    TrajectoryQuery query;
+    bool print_points = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--help" || arg == "-h")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--dir" && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (arg == "--from" && i + 1 < argc)
+        {
+            if (!parse_ms(argv[++i], query.from_ms))
+            {
+                std::cerr << "Invalid --from value (expected unix time in ms): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--to" && i + 1 < argc)
+        {
+            if (!parse_ms(argv[++i], query.to_ms))
+            {
+                std::cerr << "Invalid --to value (expected unix time in ms): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--region" && i + 1 < argc)
+        {
+            cv::Rect &r = query.region;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &r.x, &r.y, &r.width, &r.height) != 4)
+            {
+                std::cerr << "Invalid --region value (expected x,y,w,h): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--points")
+        {
+            print_points = true;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Use --help for usage information" << std::endl;
+            return 1;
+        }
+    }
+
+    if (dir.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    TrajectoryReader reader(dir);
+    auto tracks = reader.query(query);
+
+    if (print_points)
+    {
+        std::cout << "class_id,track_id,timestamp_ms,cx,cy,w,h" << std::endl;
+        for (const auto &t : tracks)
+        {
+            for (const auto &p : t.points)
+            {
+                std::cout << t.class_id << "," << t.track_id << "," << p.timestamp_ms << "," << p.center.x << "," << p.center.y
+                          << "," << p.size.width << "," << p.size.height << "\n";
+            }
+        }
+        return 0;
+    }
+
+    size_t total_points = 0;
+    for (const auto &t : tracks)
+    {
+        const auto &first = t.points.front().center;
+        const auto &last = t.points.back().center;
+        std::cout << "track " << t.track_id
+                  << "  class=" << t.class_id
+                  << "  start=" << t.start_ms
+                  << "  dwell=" << (t.end_ms - t.start_ms) / 1000.0 << "s"
+                  << "  points=" << t.points.size()
+                  << "  (" << first.x << "," << first.y << ") -> (" << last.x << "," << last.y << ")\n";
+        total_points += t.points.size();
+    }
+    std::cout << "📊 " << tracks.size() << " track(s), " << total_points << " point(s)" << std::endl;
+    return 0;
+}
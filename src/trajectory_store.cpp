@@ -0,0 +1,344 @@
+#include "trajectory_store.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char kMagic[4] = {'T', 'R', 'J', '1'};
+
+// --- Кодирование: varint (LEB128) и zigzag для знаковых дельт ---
+
+static void put_varint(vector<uint8_t> &buf, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    buf.push_back(uint8_t(v));
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+// Последовательное чтение varint из отображенной памяти
+struct Cursor
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok = true;
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p >= end)
+            {
+                ok = false;
+                return 0;
+            }
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t svarint() { return unzigzag(varint()); }
+};
+
+// --- Writer ---
+
+TrajectoryWriter::TrajectoryWriter(const string &dir, int segment_seconds)
+    : dir(dir), segment_seconds(std::max(1, segment_seconds))
+{
+    error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+        cerr << "⚠️ Can't create trajectory directory " << dir << ": " << ec.message() << endl;
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    finish_all();
+    if (file)
+        fclose(file);
+}
+
+void TrajectoryWriter::add_point(int class_id, int track_id, int64_t frame, int64_t timestamp_ms, const cv::Rect &box)
+{
+    TrajectoryPoint point;
+    point.timestamp_ms = timestamp_ms;
+    point.frame = frame;
+    point.center = cv::Point(box.x + box.width / 2, box.y + box.height / 2);
+    point.size = cv::Size(box.width, box.height);
+    active[{class_id, track_id}].push_back(point);
+}
+
+void TrajectoryWriter::finish_all()
+{
+    while (!active.empty())
+        finish_track(active.begin()->first.first, active.begin()->first.second);
+}
+
+bool TrajectoryWriter::open_segment(int64_t segment_start_s)
+{
+    if (file && segment_start_s == current_segment)
+        return true;
+    if (file)
+        fclose(file);
+
+    string path = dir + "/" + to_string(segment_start_s) + ".traj";
+    file = fopen(path.c_str(), "ab");
+    if (!file)
+    {
+        cerr << "⚠️ Can't open trajectory segment " << path << endl;
+        current_segment = -1;
+        return false;
+    }
+    current_segment = segment_start_s;
+
+    // Новый файл - пишем заголовок
+    if (ftell(file) == 0)
+    {
+        vector<uint8_t> header(kMagic, kMagic + 4);
+        put_varint(header, segment_seconds);
+        fwrite(header.data(), 1, header.size(), file);
+        total_bytes += header.size();
+    }
+    return true;
+}
+
+void TrajectoryWriter::finish_track(int class_id, int track_id)
+{
+    auto it = active.find({class_id, track_id});
+    if (it == active.end())
+        return;
+    vector<TrajectoryPoint> points = move(it->second);
+    active.erase(it);
+    if (points.empty())
+        return;
+
+    const TrajectoryPoint &first = points.front();
+    const TrajectoryPoint &last = points.back();
+    int64_t duration_ms = last.timestamp_ms - first.timestamp_ms;
+    int64_t frame_span = last.frame - first.frame;
+    // Время точек восстанавливается по номеру кадра, храним средний период кадра
+    int64_t frame_us = frame_span > 0 ? duration_ms * 1000 / frame_span : 0;
+
+    int min_x = first.center.x, max_x = first.center.x;
+    int min_y = first.center.y, max_y = first.center.y;
+    for (const auto &p : points)
+    {
+        min_x = std::min(min_x, p.center.x);
+        max_x = std::max(max_x, p.center.x);
+        min_y = std::min(min_y, p.center.y);
+        max_y = std::max(max_y, p.center.y);
+    }
+
+    vector<uint8_t> body;
+    body.reserve(32 + points.size() * 6);
+    put_varint(body, track_id);
+    put_varint(body, class_id);
+    put_varint(body, first.timestamp_ms);
+    put_varint(body, duration_ms);
+    put_varint(body, frame_us);
+    put_varint(body, points.size());
+    put_varint(body, zigzag(min_x));
+    put_varint(body, zigzag(min_y));
+    put_varint(body, zigzag(max_x));
+    put_varint(body, zigzag(max_y));
+
+    // Колонки: сначала все кадры, потом все x и т.д. - одинаковые по природе дельты рядом
+    int64_t prev = first.frame;
+    for (const auto &p : points)
+    {
+        put_varint(body, p.frame - prev);
+        prev = p.frame;
+    }
+    auto put_column = [&](auto get)
+    {
+        int64_t prev_value = 0;
+        for (const auto &p : points)
+        {
+            int64_t value = get(p);
+            put_varint(body, zigzag(value - prev_value));
+            prev_value = value;
+        }
+    };
+    put_column([](const TrajectoryPoint &p)
+               { return (int64_t)p.center.x; });
+    put_column([](const TrajectoryPoint &p)
+               { return (int64_t)p.center.y; });
+    put_column([](const TrajectoryPoint &p)
+               { return (int64_t)p.size.width; });
+    put_column([](const TrajectoryPoint &p)
+               { return (int64_t)p.size.height; });
+
+    vector<uint8_t> record;
+    put_varint(record, body.size());
+    record.insert(record.end(), body.begin(), body.end());
+
+    int64_t start_s = first.timestamp_ms / 1000;
+    if (!open_segment(start_s - start_s % segment_seconds))
+        return;
+
+    fwrite(record.data(), 1, record.size(), file);
+    fflush(file);
+
+    total_bytes += record.size();
+    total_points += points.size();
+}
+
+// --- Reader ---
+
+TrajectoryReader::TrajectoryReader(const string &dir) : dir(dir) {}
+
+vector<Trajectory> TrajectoryReader::query(const TrajectoryQuery &q) const
+{
+    vector<Trajectory> result;
+
+    error_code ec;
+    vector<pair<int64_t, string>> segments;
+    for (const auto &entry : fs::directory_iterator(dir, ec))
+    {
+        if (entry.path().extension() != ".traj")
+            continue;
+        try
+        {
+            segments.emplace_back(stoll(entry.path().stem().string()), entry.path().string());
+        }
+        catch (const std::exception &)
+        {
+            // Чужой файл - пропускаем
+        }
+    }
+    sort(segments.begin(), segments.end());
+
+    for (const auto &segment : segments)
+    {
+        // Треки лежат в сегменте по времени начала: все, что начался позже to_ms, можно не открывать
+        if (segment.first * 1000 > q.to_ms)
+            break;
+        scan_segment(segment.second, q, result);
+    }
+    return result;
+}
+
+void TrajectoryReader::scan_segment(const string &path, const TrajectoryQuery &q, vector<Trajectory> &out) const
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(kMagic))
+    {
+        close(fd);
+        return;
+    }
+
+    size_t size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return;
+
+    const uint8_t *data = static_cast<const uint8_t *>(mapped);
+    if (memcmp(data, kMagic, sizeof(kMagic)) != 0)
+    {
+        munmap(mapped, size);
+        return;
+    }
+
+    Cursor header{data + sizeof(kMagic), data + size};
+    header.varint(); // segment_seconds
+
+    const uint8_t *p = header.p;
+    const uint8_t *end = data + size;
+    while (p < end)
+    {
+        Cursor c{p, end};
+        uint64_t record_size = c.varint();
+        // Недописанная запись в конце (процесс упал во время записи)
+        if (!c.ok || record_size > (uint64_t)(end - c.p))
+            break;
+        const uint8_t *record_end = c.p + record_size;
+        p = record_end;
+
+        c.end = record_end;
+        Trajectory t;
+        t.track_id = (int)c.varint();
+        t.class_id = (int)c.varint();
+        t.start_ms = (int64_t)c.varint();
+        t.end_ms = t.start_ms + (int64_t)c.varint();
+        int64_t frame_us = (int64_t)c.varint();
+        uint64_t n = c.varint();
+        int min_x = (int)c.svarint(), min_y = (int)c.svarint();
+        int max_x = (int)c.svarint(), max_y = (int)c.svarint();
+        if (!c.ok)
+            break;
+
+        // Быстрый отсев по заголовку записи
+        if (t.start_ms > q.to_ms || t.end_ms < q.from_ms)
+            continue;
+        cv::Rect bounds(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        if (q.region.area() > 0 && (bounds & q.region).area() <= 0)
+            continue;
+
+        // Защита от мусора: на точку уходит минимум 5 байт
+        if (n == 0 || n > record_size / 5)
+            continue;
+
+        t.points.resize(n);
+        int64_t frame = 0;
+        for (auto &pt : t.points)
+        {
+            frame += (int64_t)c.varint();
+            pt.frame = frame;
+            pt.timestamp_ms = t.start_ms + frame * frame_us / 1000;
+        }
+        int64_t v = 0;
+        for (auto &pt : t.points)
+            pt.center.x = (int)(v += c.svarint());
+        v = 0;
+        for (auto &pt : t.points)
+            pt.center.y = (int)(v += c.svarint());
+        v = 0;
+        for (auto &pt : t.points)
+            pt.size.width = (int)(v += c.svarint());
+        v = 0;
+        for (auto &pt : t.points)
+            pt.size.height = (int)(v += c.svarint());
+        if (!c.ok)
+            continue;
+
+        if (q.region.area() > 0)
+        {
+            bool inside = std::any_of(t.points.begin(), t.points.end(), [&](const TrajectoryPoint &pt)
+                                      { return q.region.contains(pt.center); });
+            if (!inside)
+                continue;
+        }
+        out.push_back(move(t));
+    }
+
+    munmap(mapped, size);
+}
@@ -0,0 +1,128 @@
+#include "yolo_decoder.h"
+
+using namespace std;
+
+DecodeFn select_decoder(HeadFormat format, int num_classes)
+{
+    switch (format)
+    {
+    case HeadFormat::YOLOv8:
+        if (num_classes == 80)
+            return &HeadDecoder<HeadFormat::YOLOv8, 80>::decode; // COCO
+        if (num_classes == 1)
+            return &HeadDecoder<HeadFormat::YOLOv8, 1>::decode; // Дообученная модель "только люди"
+        return &HeadDecoder<HeadFormat::YOLOv8, 0>::decode;
+    case HeadFormat::YOLOv5:
+        if (num_classes == 80)
+            return &HeadDecoder<HeadFormat::YOLOv5, 80>::decode;
+        if (num_classes == 1)
+            return &HeadDecoder<HeadFormat::YOLOv5, 1>::decode;
+        return &HeadDecoder<HeadFormat::YOLOv5, 0>::decode;
+    case HeadFormat::EndToEnd:
+        return &HeadDecoder<HeadFormat::EndToEnd, 0>::decode;
+    }
+    return &HeadDecoder<HeadFormat::YOLOv8, 0>::decode;
+}
+
+HeadFormat detect_head_format(const vector<int64_t> &shape, int metadata_classes, bool end2end_hint)
+{
+    if (end2end_hint)
+        return HeadFormat::EndToEnd;
+    if (shape.size() != 3)
+        return HeadFormat::YOLOv8;
+
+    int64_t d1 = shape[1];
+    int64_t d2 = shape[2];
+
+    // [B, N, 6] с небольшим N (топ-K детекций) - end-to-end голова.
+    // Одноклассовый YOLOv5 тоже дает 6 в конце, но анкоров у него тысячи.
+    if (d2 == 6 && d1 > 0 && d1 <= 1000)
+        return HeadFormat::EndToEnd;
+
+    if (metadata_classes > 0)
+    {
+        if (d1 == 4 + metadata_classes)
+            return HeadFormat::YOLOv8;
+        if (d2 == 5 + metadata_classes)
+            return HeadFormat::YOLOv5;
+    }
+
+    // Без метаданных: атрибутов всегда меньше, чем анкоров
+    if (d1 > 0 && d2 > 0)
+        return d1 < d2 ? HeadFormat::YOLOv8 : HeadFormat::YOLOv5;
+    if (d1 > 0 && d2 == -1)
+        return HeadFormat::YOLOv8; // [B, 84, -1] - динамическое число анкоров
+    if (d1 == -1 && d2 > 0)
+        return HeadFormat::YOLOv5; // [B, -1, 85]
+    return HeadFormat::YOLOv8;
+}
+
+int head_num_classes(HeadFormat format, const vector<int64_t> &dims)
+{
+    switch (format)
+    {
+    case HeadFormat::YOLOv8:
+        return dims[1] > 0 ? (int)dims[1] - 4 : -1;
+    case HeadFormat::YOLOv5:
+        return dims[2] > 0 ? (int)dims[2] - 5 : -1;
+    case HeadFormat::EndToEnd:
+        return -1;
+    }
+    return -1;
+}
+
+int head_num_rows(HeadFormat format, const vector<int64_t> &dims)
+{
+    return format == HeadFormat::YOLOv8 ? (int)dims[2] : (int)dims[1];
+}
+
+int count_metadata_classes(const string &names)
+{
+    // Считаем двоеточия вне кавычек: одно на каждую пару "id: 'name'"
+    int count = 0;
+    char quote = 0;
+    for (char ch : names)
+    {
+        if (quote)
+        {
+            if (ch == quote)
+                quote = 0;
+        }
+        else if (ch == '\'' || ch == '"')
+        {
+            quote = ch;
+        }
+        else if (ch == ':')
+        {
+            count++;
+        }
+    }
+    return count > 0 ? count : -1;
+}
+
+bool parse_head_format(const string &name, HeadFormat &format)
+{
+    if (name == "v8" || name == "yolov8" || name == "v11" || name == "yolo11")
+        format = HeadFormat::YOLOv8;
+    else if (name == "v5" || name == "yolov5")
+        format = HeadFormat::YOLOv5;
+    else if (name == "e2e" || name == "v10" || name == "yolov10")
+        format = HeadFormat::EndToEnd;
+    else
+        return false;
+    return true;
+}
+
+const char *head_format_name(HeadFormat format)
+{
+    switch (format)
+    {
+    case HeadFormat::YOLOv8:
+        return "YOLOv8/11 [B, 4+C, A]";
+    case HeadFormat::YOLOv5:
+        return "YOLOv5 [B, A, 5+C]";
+    case HeadFormat::EndToEnd:
+        return "End-to-end [B, N, 6] (NMS-free)";
+    }
+    return "unknown";
+}
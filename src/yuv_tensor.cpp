@@ -0,0 +1,93 @@
+#include "yuv_tensor.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+void yuv_to_tensor(const cv::Mat &yuv, YuvLayout layout, const cv::Rect &src_rect,
+                   int dst_w, int dst_h, float *dst)
+{
+    const cv::Size size = yuv_image_size(yuv);
+    const int width = size.width;
+    const int height = size.height;
+    const size_t stride = yuv.step;
+    const uint8_t *y_plane = yuv.data;
+
+    // Начала плоскостей цветности (кадр от декодера непрерывный)
+    const uint8_t *uv_plane = y_plane + stride * height;
+    const size_t chroma_stride = layout == YuvLayout::NV12 ? stride : stride / 2;
+    const uint8_t *v_plane = uv_plane + chroma_stride * (height / 2);
+
+    const float scale_x = (float)src_rect.width / dst_w;
+    const float scale_y = (float)src_rect.height / dst_h;
+
+    // Таблицы по X считаем один раз на кадр, а не для каждой строки
+    thread_local vector<int> x0, cx;
+    thread_local vector<float> wx;
+    x0.resize(dst_w);
+    cx.resize(dst_w);
+    wx.resize(dst_w);
+    for (int x = 0; x < dst_w; x++)
+    {
+        float sx = (x + 0.5f) * scale_x - 0.5f + src_rect.x;
+        sx = std::clamp(sx, 0.0f, (float)(width - 1));
+        int ix = std::min((int)sx, width - 2);
+        x0[x] = ix;
+        wx[x] = sx - ix;
+        cx[x] = std::min((int)(sx + 0.5f), width - 1) / 2;
+    }
+
+    const size_t plane = (size_t)dst_w * dst_h;
+    float *r_out = dst;
+    float *g_out = dst + plane;
+    float *b_out = dst + 2 * plane;
+
+    for (int y = 0; y < dst_h; y++)
+    {
+        float sy = (y + 0.5f) * scale_y - 0.5f + src_rect.y;
+        sy = std::clamp(sy, 0.0f, (float)(height - 1));
+        int iy = std::min((int)sy, height - 2);
+        float wy = sy - iy;
+        int cy = std::min((int)(sy + 0.5f), height - 1) / 2;
+
+        const uint8_t *row0 = y_plane + stride * iy;
+        const uint8_t *row1 = row0 + stride;
+        const uint8_t *u_row = uv_plane + chroma_stride * cy;
+        const uint8_t *v_row = v_plane + chroma_stride * cy;
+
+        size_t out = (size_t)y * dst_w;
+        for (int x = 0; x < dst_w; x++, out++)
+        {
+            int ix = x0[x];
+            float top = row0[ix] + (row0[ix + 1] - row0[ix]) * wx[x];
+            float bottom = row1[ix] + (row1[ix + 1] - row1[ix]) * wx[x];
+            float luma = top + (bottom - top) * wy;
+
+            float u, v;
+            if (layout == YuvLayout::NV12)
+            {
+                u = u_row[2 * cx[x]];
+                v = u_row[2 * cx[x] + 1];
+            }
+            else
+            {
+                u = u_row[cx[x]];
+                v = v_row[cx[x]];
+            }
+
+            // BT.601 limited range, сразу с нормализацией 1/255
+            float c = 1.164f * (luma - 16.0f);
+            float d = u - 128.0f;
+            float e = v - 128.0f;
+            r_out[out] = std::clamp((c + 1.596f * e) * (1.0f / 255.0f), 0.0f, 1.0f);
+            g_out[out] = std::clamp((c - 0.392f * d - 0.813f * e) * (1.0f / 255.0f), 0.0f, 1.0f);
+            b_out[out] = std::clamp((c + 2.017f * d) * (1.0f / 255.0f), 0.0f, 1.0f);
+        }
+    }
+}
+
+void yuv_to_bgr(const cv::Mat &yuv, YuvLayout layout, cv::Mat &bgr)
+{
+    cv::cvtColor(yuv, bgr, layout == YuvLayout::NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+}